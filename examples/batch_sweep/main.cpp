@@ -0,0 +1,167 @@
+#include "hermes1d.h"
+#include "solver_umfpack.h"
+
+// ********************************************************************
+
+// This example solves the nonlinear equation -u'' + K u^3 = 0 in
+// an interval (A, B) with the Dirichlet conditions u(A) = U_A, 
+// u(B) = 0, for N_inst combinations of the parameters K and U_A. 
+// All instances share the mesh, the weak forms and the sparsity 
+// pattern, and they are solved concurrently by BatchSolver, or
+// ENS_W instances at a time by the ensemble (SIMD) assembly.
+
+// General input:
+static int N_eq = 1;
+int N_elem = 40;                        // number of elements
+double A = 0, B = 1;                    // domain end points
+int P_init = 3;                         // initial polynomal degree
+
+// Parameter sweep
+int N_inst = 100;                       // number of instances
+int N_threads = 4;                      // number of threads
+int Use_ensemble = 0;                   // 1... ensemble forms, solve_ensemble()
+
+// Tolerance for the Newton's method
+double TOL = 1e-10;
+
+// parameters of one instance
+struct Params {
+  double K;
+};
+
+// ********************************************************************
+
+// bilinear form for the Jacobi matrix 
+double jacobian(int num, double *x, double *weights, 
+                double *u, double *dudx, double *v, double *dvdx, 
+                double u_prev[MAX_EQN_NUM][MAX_PTS_NUM], 
+                double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM], 
+                void *user_data)
+{
+  double K = ((Params *) user_data)->K;
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    val += (dudx[i]*dvdx[i] + 3*K*u_prev[0][i]*u_prev[0][i]*u[i]*v[i])*weights[i];
+  }
+  return val;
+};
+
+// (nonlinear) form for the residual vector
+double residual(int num, double *x, double *weights, 
+                double u_prev[MAX_EQN_NUM][MAX_PTS_NUM], 
+                double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM],  
+                double *v, double *dvdx, void *user_data)
+{
+  double K = ((Params *) user_data)->K;
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    double u = u_prev[0][i];
+    val += (du_prevdx[0][i]*dvdx[i] + K*u*u*u*v[i])*weights[i];
+  }
+  return val;
+};
+
+// ensemble versions of the forms, for ENS_W instances at once
+void jacobian_ens(int num, double *x, double *weights, 
+                  double *u, double *dudx, double *v, double *dvdx, 
+                  double u_prev[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W], 
+                  double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W], 
+                  void **user_data, double *val)
+{
+  double K[ENS_W];
+  for(int w = 0; w<ENS_W; w++) {
+    K[w] = ((Params *) user_data[w])->K;
+    val[w] = 0;
+  }
+  for(int i = 0; i<num; i++) {
+    double d = dudx[i]*dvdx[i]*weights[i];
+    double m = 3*u[i]*v[i]*weights[i];
+    for(int w = 0; w<ENS_W; w++) 
+      val[w] += d + K[w]*u_prev[0][i][w]*u_prev[0][i][w]*m;
+  }
+};
+
+void residual_ens(int num, double *x, double *weights, 
+                  double u_prev[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W], 
+                  double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W],  
+                  double *v, double *dvdx, void **user_data, double *val)
+{
+  double K[ENS_W];
+  for(int w = 0; w<ENS_W; w++) {
+    K[w] = ((Params *) user_data[w])->K;
+    val[w] = 0;
+  }
+  for(int i = 0; i<num; i++) {
+    double dv = dvdx[i]*weights[i];
+    double vv = v[i]*weights[i];
+    for(int w = 0; w<ENS_W; w++) {
+      double u = u_prev[0][i][w];
+      val[w] += du_prevdx[0][i][w]*dv + K[w]*u*u*u*vv;
+    }
+  }
+};
+
+/******************************************************************************/
+int main() {
+  intro();
+
+  // create mesh
+  Mesh mesh(N_eq);
+  mesh.create(A, B, N_elem);
+  mesh.set_uniform_poly_order(P_init);
+  mesh.set_bc_left_dirichlet(0, 1);
+  mesh.set_bc_right_dirichlet(0, 0);
+  int N_dof = mesh.assign_dofs();
+  printf("N_dof = %d\n", N_dof);
+
+  // register weak forms
+  DiscreteProblem dp(&mesh);
+  dp.add_matrix_form(0, 0, jacobian);
+  dp.add_vector_form(0, residual);
+
+  // instances: K in [0, 100), U_A in [1, 2)
+  Params *params = new Params[N_inst];
+  double *u_a = new double[N_inst];
+  double *u_b = new double[N_inst];
+  ProblemInstance *inst = new ProblemInstance[N_inst];
+  double **y = new_matrix<double>(N_inst, N_dof);
+  for(int k=0; k<N_inst; k++) {
+    params[k].K = 100.*k/N_inst;
+    u_a[k] = 1 + (k % 10)/10.;
+    u_b[k] = 0;
+    inst[k].user_data = params + k;
+    inst[k].bc_left_dir_values = u_a + k;
+    inst[k].bc_right_dir_values = u_b + k;
+    // zero initial condition for the Newton's method
+    for(int i=0; i<N_dof; i++) y[k][i] = 0;
+  }
+
+  int *iters = new int[N_inst];
+  int n_failed;
+  // one solver per thread
+  Solver **solvers = new Solver*[N_threads];
+  for(int t=0; t<N_threads; t++) solvers[t] = new UmfpackSolver();
+  if(Use_ensemble) {
+    EnsembleProblem ep(&mesh);
+    ep.add_matrix_form(0, 0, jacobian_ens);
+    ep.add_vector_form(0, residual_ens);
+    n_failed = solve_ensemble(&ep, solvers[0], N_inst, inst, y, iters, TOL, 50);
+  }
+  else {
+    BatchSolver batch(&dp, solvers, N_threads);
+    batch.set_newton(TOL, 50);
+    n_failed = batch.solve(N_inst, inst, y, iters);
+  }
+  printf("Instances: %d, not converged: %d\n", N_inst, n_failed);
+
+  // solution value in the middle of the interval (vertex N_elem/2)
+  Element *elems = mesh.get_elems();
+  int mid_dof = elems[N_elem/2 - 1].dof[0][1];
+  for(int k=0; k<N_inst; k+=N_inst/9) 
+    printf("K = %g, u(A) = %g: %d iterations, u(%g) = %.10f\n", params[k].K, u_a[k], 
+           iters[k], elems[N_elem/2 - 1].v2->x, y[k][mid_dof]);
+
+  for(int t=0; t<N_threads; t++) delete solvers[t];
+  printf("Done.\n");
+  return 1;
+}
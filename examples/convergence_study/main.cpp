@@ -0,0 +1,109 @@
+#include "hermes1d.h"
+#include "solver_umfpack.h"
+
+// ********************************************************************
+
+// This example compares h-, p- and hp-refinement for the singularly
+// perturbed problem -EPS u'' + u = 1 in (0, 1) with u(0) = u(1) = 0,
+// whose solution has boundary layers of width sqrt(EPS). The problem is
+// solved on uniform meshes for all combinations of the numbers of
+// elements and degrees below; the table in convergence.dat lists the
+// DOFs, the nonzeros, the Newton iterations, the assembly and solve
+// times and the errors of every discretization. Plot e.g. the H1 error
+// against n_dof for every p.
+
+// General input:
+static int N_eq = 1;
+double A = 0, B = 1;                    // domain end points
+double EPS = 1e-3;                      // diffusion coefficient
+
+// Discretizations of the study
+const int N_meshes = 6;
+int N_elems[N_meshes] = {2, 4, 8, 16, 32, 64};
+const int N_degrees = 5;
+int Degrees[N_degrees] = {1, 2, 3, 5, 8};
+
+// Measure the errors against a reference solution on Ref_n_elem elements
+// of degree Ref_p instead of the exact solution
+int Use_reference = 0;
+int Ref_n_elem = 128, Ref_p = 10;
+
+// Tolerance for the Newton's method
+double TOL = 1e-10;
+
+// ********************************************************************
+
+// bilinear form for the Jacobi matrix 
+double jacobian(int num, double *x, double *weights, 
+                double *u, double *dudx, double *v, double *dvdx, 
+                double u_prev[MAX_EQN_NUM][MAX_PTS_NUM], 
+                double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM], 
+                void *user_data)
+{
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    val += (EPS*dudx[i]*dvdx[i] + u[i]*v[i])*weights[i];
+  }
+  return val;
+};
+
+// residual vector
+double residual(int num, double *x, double *weights, 
+                double u_prev[MAX_EQN_NUM][MAX_PTS_NUM], 
+                double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM],  
+                double *v, double *dvdx, void *user_data)
+{
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    val += (EPS*du_prevdx[0][i]*dvdx[i] + (u_prev[0][i] - 1)*v[i])*weights[i];
+  }
+  return val;
+};
+
+// exact solution
+void exact_sol(double x, double *val, double *der, void *user_data)
+{
+  double s = sqrt(EPS);
+  double c = cosh(0.5/s);
+  val[0] = 1 - cosh((x - 0.5)/s)/c;
+  der[0] = -sinh((x - 0.5)/s)/(s*c);
+}
+
+void set_bc(Mesh *mesh, void *user_data)
+{
+  mesh->set_bc_left_dirichlet(0, 0);
+  mesh->set_bc_right_dirichlet(0, 0);
+}
+
+void add_forms(DiscreteProblem *dp, void *user_data)
+{
+  dp->add_matrix_form(0, 0, jacobian);
+  dp->add_vector_form(0, residual);
+}
+
+/******************************************************************************/
+int main() {
+  intro();
+
+  ConvergenceProblem problem;
+  problem.n_eq = N_eq;
+  problem.a = A;
+  problem.b = B;
+  problem.set_bc = set_bc;
+  problem.add_forms = add_forms;
+  problem.user_data = NULL;
+  problem.exact = Use_reference ? NULL : exact_sol;
+  problem.exact_data = NULL;
+  problem.ref_n_elem = Ref_n_elem;
+  problem.ref_p = Ref_p;
+
+  UmfpackSolver solver;
+  ConvergenceResult results[N_meshes*N_degrees];
+  run_convergence_study(&problem, &solver, N_meshes, N_elems, N_degrees, Degrees,
+                        results, TOL);
+  write_convergence_table(NULL, results, N_meshes*N_degrees);
+  write_convergence_table("convergence.dat", results, N_meshes*N_degrees);
+
+  printf("Done.\n");
+  return 1;
+}
@@ -1,5 +1,4 @@
 #include "hermes1d.h"
-#include "solver_umfpack.h"
 
 // ********************************************************************
 
@@ -72,6 +71,8 @@ double residual(int num, double *x, double *weights,
 
 /******************************************************************************/
 int main() {
+  intro();
+
   // create mesh
   Mesh mesh(N_eq);
   mesh.create(A, B, N_elem);
@@ -85,51 +86,17 @@ int main() {
   dp.add_matrix_form(0, 0, jacobian);
   dp.add_vector_form(0, residual);
 
-  // allocate Jacobi matrix and residual
-  Matrix *mat;
-  double *y_prev = new double[N_dof];
-  double *res = new double[N_dof];
-
-  // zero initial condition for the Newton's method
-  for(int i=0; i<N_dof; i++) y_prev[i] = 0; 
-
-  // Newton's loop
-  int newton_iterations = 0;
-  while (1) {
-    // zero the matrix:
-    mat = new CooMatrix(N_dof);
-
-    // construct residual vector
-    dp.assemble_matrix_and_vector(mat, res, y_prev); 
-
-    // calculate L2 norm of residual vector
-    double res_norm = 0;
-    for(int i=0; i<N_dof; i++) res_norm += res[i]*res[i];
-    res_norm = sqrt(res_norm);
+  // solution vector
+  double *y = new double[N_dof];
 
-    // if residual norm less than TOL, quit
-    // latest solution is in y_prev
-    printf("Residual L2 norm: %.15f\n", res_norm);
-    if (DEBUG)
-        printf("TOL: %.15f\n", TOL);
-    if(res_norm < TOL) break;
-
-    // changing sign of vector res
-    for(int i=0; i<N_dof; i++) res[i]*= -1;
-
-    // solving the matrix system
-    solve_linear_system_umfpack((CooMatrix*)mat, res);
-
-    // updating y_prev by new solution which is in res
-    for(int i=0; i<N_dof; i++) y_prev[i] += res[i];
-
-    newton_iterations++;
-    printf("Finished Newton iteration: %d\n", newton_iterations);
-  }
+  // the problem is solved element by element from the left to the
+  // right, with Newton's method in each element
+  int newton_iterations = dp.solve_marching(y, TOL);
+  printf("Total number of Newton iterations: %d\n", newton_iterations);
 
   Linearizer l(&mesh);
   const char *out_filename = "solution.gp";
-  l.plot_solution(out_filename, y_prev);
+  l.plot_solution(out_filename, y);
 
   printf("Done.\n");
   return 1;
@@ -28,26 +28,10 @@ double f(double x) {
 
 // ********************************************************************
 
-// bilinear form for the Jacobi matrix 
-// num...number of Gauss points in element
-// x[]...Gauss points
-// weights[]...Gauss weights for points in x[]
-// u...basis function
-// v...test function
-// u_prev...previous solution (all solution components)
-double jacobian(int num, double *x, double *weights, 
-                double *u, double *dudx, double *v, double *dvdx, 
-                double u_prev[MAX_EQN_NUM][MAX_PTS_NUM], double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM], 
-                void *user_data)
-{
-  double val = 0;
-  for(int i = 0; i<num; i++) {
-    val += dudx[i]*dvdx[i]*weights[i];
-  }
-  return val;
-};
+// The Jacobi matrix -u'' is the built-in diffusion operator, which
+// also contributes the term u'v' to the residual vector (see main()).
 
-// (nonlinear) form for the residual vector
+// remaining part of the residual vector
 // num...number of Gauss points in element
 // x[]...Gauss points
 // weights[]...Gauss weights for points in x[]
@@ -60,13 +44,15 @@ double residual(int num, double *x, double *weights,
 {
   double val = 0;
   for(int i = 0; i<num; i++) {
-    val += (du_prevdx[0][i]*dvdx[i] - f(x[i])*v[i])*weights[i];
+    val -= f(x[i])*v[i]*weights[i];
   }
   return val;
 };
 
 /******************************************************************************/
 int main() {
+  intro();
+
   // create mesh
   Mesh mesh(N_eq);
   mesh.create(A, B, N_elem);
@@ -78,7 +64,7 @@ int main() {
 
   // register weak forms
   DiscreteProblem dp(&mesh);
-  dp.add_matrix_form(0, 0, jacobian);
+  dp.add_operator(0, 0, OP_DIFFUSION, 1.0);
   dp.add_vector_form(0, residual);
 
   // allocate Jacobi matrix and residual
@@ -99,6 +99,8 @@ double residual_surf_right(double x, double u_prev[MAX_EQN_NUM],
 
 /******************************************************************************/
 int main() {
+  intro();
+
   // create mesh
   Mesh mesh(N_eq);
   mesh.create(A, B, N_elem);
@@ -0,0 +1,121 @@
+#include "hermes1d.h"
+#include "solver_umfpack.h"
+
+// ********************************************************************
+
+// This example solves the strongly nonlinear equation -u'' + K u^3 = 0
+// in an interval (A, B) with the Dirichlet conditions u(A) = U_A,
+// u(B) = 0 by nested iteration: the problem is solved first on a coarse
+// mesh, and the converged solution is the initial guess for Newton's
+// method on the next finer mesh (h-refinement, then p-enrichment on the
+// last level). For comparison, the finest problem is also solved with
+// the zero initial guess and with an analytic guess projected onto the
+// finest mesh.
+
+// General input:
+static int N_eq = 1;
+double A = 0, B = 1;                    // domain end points
+double K = 50;                          // coefficient of the nonlinearity
+double U_A = 5;                         // Dirichlet value at A
+
+// Mesh levels (number of elements, polynomial degree)
+const int N_levels = 5;
+int Level_elems[N_levels] = {4, 8, 16, 32, 32};
+int Level_p[N_levels] = {2, 2, 2, 2, 4};
+
+// Tolerance for the Newton's method
+double TOL = 1e-10;
+
+// ********************************************************************
+
+// bilinear form for the Jacobi matrix 
+double jacobian(int num, double *x, double *weights, 
+                double *u, double *dudx, double *v, double *dvdx, 
+                double u_prev[MAX_EQN_NUM][MAX_PTS_NUM], 
+                double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM], 
+                void *user_data)
+{
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    val += (dudx[i]*dvdx[i] + 3*K*u_prev[0][i]*u_prev[0][i]*u[i]*v[i])*weights[i];
+  }
+  return val;
+};
+
+// (nonlinear) form for the residual vector
+double residual(int num, double *x, double *weights, 
+                double u_prev[MAX_EQN_NUM][MAX_PTS_NUM], 
+                double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM],  
+                double *v, double *dvdx, void *user_data)
+{
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    double u = u_prev[0][i];
+    val += (du_prevdx[0][i]*dvdx[i] + K*u*u*u*v[i])*weights[i];
+  }
+  return val;
+};
+
+// analytic initial guess (with the right boundary values)
+void initial_guess(double x, double *val, double *der, void *user_data)
+{
+  double s = (B - x)/(B - A);
+  val[0] = U_A*s*s*s;
+  der[0] = -3*U_A*s*s/(B - A);
+}
+
+/******************************************************************************/
+int main() {
+  intro();
+
+  // create the meshes of all levels
+  Mesh *meshes[N_levels];
+  for(int l=0; l<N_levels; l++) {
+    meshes[l] = new Mesh(N_eq);
+    meshes[l]->create(A, B, Level_elems[l]);
+    meshes[l]->set_uniform_poly_order(Level_p[l]);
+    meshes[l]->set_bc_left_dirichlet(0, U_A);
+    meshes[l]->set_bc_right_dirichlet(0, 0);
+    meshes[l]->assign_dofs();
+  }
+  Mesh *fine = meshes[N_levels-1];
+  int N_dof = fine->get_n_dof();
+  printf("N_dof = %d\n", N_dof);
+
+  // register weak forms
+  DiscreteProblem dp(meshes[0]);
+  dp.add_matrix_form(0, 0, jacobian);
+  dp.add_vector_form(0, residual);
+
+  UmfpackSolver solver;
+  double *y = new double[N_dof];
+  int iters[N_levels];
+  int fine_iters = solve_nested(&dp, meshes, N_levels, &solver, y, iters, TOL);
+  if(fine_iters < 0) error("Newton's method did not converge.");
+  for(int l=0; l<N_levels; l++) 
+    printf("Level %d (%d elements, p = %d, N_dof = %d): %d Newton iterations\n", 
+           l, Level_elems[l], Level_p[l], meshes[l]->get_n_dof(), iters[l]);
+
+  // the same problem on the finest mesh from the zero initial guess
+  double *y_zero = new double[N_dof];
+  for(int i=0; i<N_dof; i++) y_zero[i] = 0;
+  int zero_iters = solve_newton(&dp, &solver, y_zero, TOL);
+  printf("Finest mesh from zero: %d Newton iterations\n", zero_iters);
+
+  // the finest mesh from the projected analytic guess
+  double *y_guess = new double[N_dof];
+  project_function(fine, initial_guess, NULL, y_guess);
+  int guess_iters = solve_newton(&dp, &solver, y_guess, TOL);
+  printf("Finest mesh from the projected guess: %d Newton iterations\n", guess_iters);
+
+  double diff = 0;
+  for(int i=0; i<N_dof; i++) diff = std::max(diff, fabs(y[i] - y_zero[i]));
+  printf("Max difference of the solutions: %g\n", diff);
+
+  Linearizer l(fine);
+  const char *out_filename = "solution.gp";
+  l.plot_solution(out_filename, y);
+
+  printf("Done.\n");
+  return 1;
+}
@@ -6,6 +6,13 @@ static int N_eq = 1;
 int N_elem = 100;                         // number of elements
 double A = 0, B = 20;                // domain end points
 int P_init = 2;                        // initial polynomal degree
+int N_eig = 5;                         // number of eigenvalues to compute
+double Sigma = -1;                     // shift (below the lowest energy)
+// spectrum slicing: compute all energies in [E_min, E_max) instead of
+// the N_eig lowest ones (set N_eig to the maximum expected number)
+int Use_slicing = 0;
+double E_min = -1, E_max = -0.01;
+int N_threads = 4;
 
 double l = 0;
 
@@ -55,21 +62,10 @@ double residual(int num, double *x, double *weights, double u_prev[MAX_EQN_NUM][
 }
 
 
-void insert_matrix(DenseMatrix *mat, int len)
-{
-  double _mat[len*len];
-  for(int i=0; i<len; i++)
-      for(int j=0; j<len; j++)
-          _mat[i*len+j] = mat->get(i, j);
-  insert_object("len", c2py_int(len));
-  insert_object("mat", c2numpy_double(_mat, len*len));
-  cmd("_ = mat.reshape((len, len))");
-  cmd("del len");
-  cmd("del mat");
-}
-
 /******************************************************************************/
 int main(int argc, char* argv[]) {
+  intro();
+
   // create mesh
   Mesh mesh(N_eq);
   mesh.create(A, B, N_elem);
@@ -81,6 +77,10 @@ int main(int argc, char* argv[]) {
   int N_dof = mesh.assign_dofs();
   printf("ndofs: %d", N_dof);
 
+  // permutation of the DOF that makes the matrices banded
+  int *perm = new int[N_dof];
+  int bandwidth = band_ordering(&mesh, perm);
+
   // register weak forms
   DiscreteProblem dp1(&mesh);
   dp1.add_matrix_form(0, 0, lhs);
@@ -90,17 +90,32 @@ int main(int argc, char* argv[]) {
   DiscreteProblem dp3(&mesh);
   dp3.add_vector_form(0, residual);
 
-  // allocate Jacobi matrix and residual
-  DenseMatrix *mat1 = new DenseMatrix(N_dof);
-  DenseMatrix *mat2 = new DenseMatrix(N_dof);
+  // allocate the (symmetric banded) matrices
+  BandMatrix *mat1 = new BandMatrix(N_dof, bandwidth, perm);
+  BandMatrix *mat2 = new BandMatrix(N_dof, bandwidth, perm);
   double *y_prev = new double[N_dof];
 
-  // zero initial condition for the Newton's method
+  // the forms are bilinear, the coefficient vector is not used
   for(int i=0; i<N_dof; i++) y_prev[i] = 0; 
 
   dp1.assemble_matrix(mat1, y_prev);
   dp2.assemble_matrix(mat2, y_prev);
 
+  // solve the generalized eigenproblem A v = E B v for the lowest energies
+  double *eigvals = new double[N_eig];
+  double **eigvecs = new_matrix<double>(N_eig, N_dof);
+  if (Use_slicing) {
+    N_eig = solve_eigen_interval(mat1, mat2, E_min, E_max, N_eig, eigvals, eigvecs,
+            N_threads);
+  }
+  else {
+    int n_conv = solve_eigen_problem(mat1, mat2, Sigma, N_eig, eigvals, eigvecs);
+    if (n_conv < N_eig) printf("Warning: only %d eigenvalues converged.\n", n_conv);
+  }
+  printf("eigenvalues:\n");
+  for(int i=0; i<N_eig; i++) printf("E[%d]=%.10f\n", i, eigvals[i]);
+  double *v = eigvecs[0];
+
   printf("Importing hermes1d\n");
   // Initialize Python
   Py_Initialize();
@@ -109,21 +124,18 @@ int main(int argc, char* argv[]) {
       throw std::runtime_error("hermes1d failed to import.");
 
   cmd("print 'Python initialized'");
-  insert_matrix(mat1, N_dof); cmd("A = _");
-  insert_matrix(mat2, N_dof); cmd("B = _");
-  cmd("from utils import solve");
-  cmd("eigs = solve(A, B)");
-  cmd("E, v = eigs[0]");
-  //cmd("print 'v[0]', v[0]");
-  //cmd("print E");
-  double *v;
-  int n;
-  numpy2c_double_inplace(get_object("v"), &v, &n);
+  // list of the (energy, eigenvector) pairs for plotting
+  insert_object("E", c2numpy_double(eigvals, N_eig));
+  cmd("eigs = []");
+  for(int i=0; i<N_eig; i++) {
+    insert_object("i", c2py_int(i));
+    insert_object("v", c2numpy_double(eigvecs[i], N_dof));
+    cmd("eigs.append((E[i], v))");
+  }
+  cmd("del E, i, v");
 
   double *res = new double[N_dof];
-  E = py2c_double(get_object("E"));
-  printf("E=%.10f\n", E);
-  E = -0.5;
+  E = eigvals[0];
   dp3.assemble_vector(res, v);
   // calculate L2 norm of residual vector
   double res_norm = 0;
@@ -118,6 +118,8 @@ double residual_1(int num, double *x, double *weights,
 
 /******************************************************************************/
 int main() {
+  intro();
+
   // create mesh
   Mesh mesh(N_eq);
   mesh.create(A, B, N_elem);
@@ -129,12 +131,13 @@ int main() {
   int N_dof = mesh.assign_dofs();
   printf("N_dof = %d\n", N_dof);
 
-  // register weak forms
+  // register weak forms (the Jacobi matrix blocks do not depend 
+  // on y_prev, so they are assembled only once)
   DiscreteProblem dp(&mesh);
-  dp.add_matrix_form(0, 0, jacobian_0_0);
-  dp.add_matrix_form(0, 1, jacobian_0_1);
-  dp.add_matrix_form(1, 0, jacobian_1_0);
-  dp.add_matrix_form(1, 1, jacobian_1_1);
+  dp.add_matrix_form(0, 0, jacobian_0_0, FORM_CONST);
+  dp.add_matrix_form(0, 1, jacobian_0_1, FORM_CONST);
+  dp.add_matrix_form(1, 0, jacobian_1_0, FORM_CONST);
+  dp.add_matrix_form(1, 1, jacobian_1_1, FORM_CONST);
   dp.add_vector_form(0, residual_0);
   dp.add_vector_form(1, residual_1);
 
@@ -106,6 +106,8 @@ double residual_1(int num, double *x, double *weights,
 
 /******************************************************************************/
 int main() {
+  intro();
+
   // create mesh
   Mesh mesh(N_eq);
   mesh.create(A, B, N_elem);
@@ -0,0 +1,175 @@
+#include "hermes1d.h"
+#include "solver_umfpack.h"
+
+// ********************************************************************
+
+// This example solves the reaction-diffusion equation 
+// du/dt - u'' + K u = 0 in an interval (A, B) with zero Dirichlet
+// conditions and the initial condition u(x, 0) = sin(x). The exact
+// solution is u(x, t) = exp(-(1 + K) t) sin(x). The problem is 
+// linear, so the factorized matrix is reused in all time steps.
+
+// General input:
+static int N_eq = 1;
+int N_elem = 20;                        // number of elements
+double A = 0, B = M_PI;                 // domain end points
+int P_init = 3;                         // initial polynomal degree
+double K = 1;                           // reaction coefficient
+
+// Time stepping
+int Method = TS_CRANK_NICOLSON;         // TS_IMPLICIT_EULER, TS_BDF2, TS_CRANK_NICOLSON
+double T_final = 1;                     // final time
+int N_steps = 100;                      // number of time steps
+// write a snapshot every Snapshot_every fixed time steps (0... none),
+// in the background while the time stepping goes on
+int Snapshot_every = 0;
+
+// Adaptive time stepping (SDIRK2) instead of the fixed step Method
+int Adaptive = 0;
+double RTOL = 1e-5, ATOL = 1e-8;        // tolerances of the local error
+
+// Explicit Runge-Kutta method with the lumped mass matrix instead of
+// Method (the step has to satisfy the stability limit ~ h^2). The
+// lumped mass matrix needs linear elements, so P_init is not used.
+int Explicit = 0;
+int Explicit_method = TS_SSP_RK3;       // TS_SSP_RK2, TS_SSP_RK3, TS_RK4
+int N_steps_explicit = 20000;
+int N_threads = 1;                      // threads of the residual assembly
+
+// Initial condition
+double u0(double x) {
+  return sin(x);
+}
+
+// ********************************************************************
+
+// L2 projection of the initial condition: residual \int u v - \int u0 v
+double proj_residual(int num, double *x, double *weights, 
+                double u_prev[MAX_EQN_NUM][MAX_PTS_NUM], double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM],  
+                double *v, double *dvdx, void *user_data)
+{
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    val -= u0(x[i])*v[i]*weights[i];
+  }
+  return val;
+};
+
+// exact solution at the time *(double *)user_data
+void exact_sol(double x, double *val, double *der, void *user_data)
+{
+  double t = *(double *)user_data;
+  val[0] = exp(-(1 + K)*t)*sin(x);
+  der[0] = exp(-(1 + K)*t)*cos(x);
+}
+
+/******************************************************************************/
+int main() {
+  intro();
+
+  // create mesh
+  Mesh mesh(N_eq);
+  mesh.create(A, B, N_elem);
+  mesh.set_uniform_poly_order(Explicit ? 1 : P_init);
+  mesh.set_bc_left_dirichlet(0, 0);
+  mesh.set_bc_right_dirichlet(0, 0);
+  int N_dof = mesh.assign_dofs();
+  printf("N_dof = %d\n", N_dof);
+
+  // project the initial condition (one Newton step of a linear problem)
+  DiscreteProblem dp_proj(&mesh);
+  dp_proj.add_operator(0, 0, OP_MASS, 1.0);
+  dp_proj.add_vector_form(0, proj_residual);
+  double *y0 = new double[N_dof];
+  double *res = new double[N_dof];
+  for(int i=0; i<N_dof; i++) y0[i] = 0; 
+  CooMatrix *mat = new CooMatrix(N_dof);
+  dp_proj.assemble_matrix_and_vector(mat, res, y0); 
+  for(int i=0; i<N_dof; i++) res[i] *= -1;
+  solve_linear_system_umfpack(mat, res);
+  for(int i=0; i<N_dof; i++) y0[i] = res[i];
+  delete mat;
+
+  // mass matrix and spatial operator -u'' + K u
+  DiscreteProblem dp_mass(&mesh);
+  dp_mass.add_operator(0, 0, OP_MASS, 1.0);
+  DiscreteProblem dp(&mesh);
+  dp.add_operator(0, 0, OP_DIFFUSION, 1.0);
+  dp.add_operator(0, 0, OP_REACTION, K);
+
+  // solution at the final time
+  double *y = new double[N_dof];
+  double t;
+  if (Explicit) {
+    DiscreteProblem dp_lumped(&mesh);
+    dp_lumped.add_operator(0, 0, OP_MASS_LUMPED, 1.0);
+    ExplicitTimeStepper ets(&dp_lumped, &dp, Explicit_method, N_threads);
+    ets.set_initial_condition(y0);
+    double dt = T_final/N_steps_explicit;
+    for(int n=0; n<N_steps_explicit; n++) ets.step(dt);
+    for(int i=0; i<N_dof; i++) y[i] = ets.get_solution()[i];
+    t = ets.get_time();
+  }
+  else {
+    UmfpackSolver solver;
+    TimeStepper *ts;
+    if (Adaptive) {
+      AdaptiveTimeStepper *ats = new AdaptiveTimeStepper(&dp_mass, &dp, &solver);
+      ats->set_linear(true);
+      ats->set_tolerances(RTOL, ATOL);
+      ats->set_dt(T_final/N_steps);
+      ats->set_initial_condition(y0);
+      ats->integrate(T_final);
+      printf("Accepted steps: %d, rejected steps: %d\n", ats->get_n_accepted(),
+             ats->get_n_rejected());
+      ts = ats;
+    }
+    else {
+      ts = new TimeStepper(&dp_mass, &dp, &solver, Method);
+      ts->set_linear(true);
+      ts->set_initial_condition(y0);
+      double dt = T_final/N_steps;
+      AsyncWriter snapshots(&mesh);
+      for(int n=0; n<N_steps; n++) {
+        ts->step(dt);
+        if (Snapshot_every > 0 && (n + 1) % Snapshot_every == 0) {
+          char filename[MAX_STRING_LENGTH];
+          sprintf(filename, "snapshot_%04d.bin", n + 1);
+          snapshots.submit(filename, ts->get_solution(), OUT_BINARY);
+        }
+      }
+      snapshots.flush();
+    }
+    printf("Number of factorizations: %d\n", ts->get_n_factorizations());
+    for(int i=0; i<N_dof; i++) y[i] = ts->get_solution()[i];
+    t = ts->get_time();
+    delete ts;
+  }
+  printf("Time: %g\n", t);
+
+  // error at the vertices (the vertex coefficients are the values there)
+  double err = 0;
+  Element *elems = mesh.get_elems();
+  for(int m=0; m<N_elem-1; m++) {
+    double x = elems[m].v2->x;
+    double exact = exp(-(1 + K)*t)*sin(x);
+    double e = fabs(y[elems[m].dof[0][1]] - exact);
+    if (e > err) err = e;
+  }
+  printf("Max error at the vertices: %g\n", err);
+
+  // error norms in the whole interval
+  Functionals f(&mesh);
+  f.add_builtin(FUNC_L2_ERROR, 0, exact_sol, &t);
+  f.add_builtin(FUNC_H1_ERROR, 0, exact_sol, &t);
+  double norms[2];
+  f.evaluate(y, norms);
+  printf("L2 error: %g, H1 error: %g\n", norms[0], norms[1]);
+
+  Linearizer l(&mesh);
+  const char *out_filename = "solution.gp";
+  l.plot_solution(out_filename, y);
+
+  printf("Done.\n");
+  return 1;
+}
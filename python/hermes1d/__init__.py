@@ -1 +1,4 @@
-from _hermes1d import Vertex, Element, Mesh, Linearizer
+from _hermes1d import Vertex, Element, Mesh, Linearizer, Functionals, \
+        FUNC_INTEGRAL, FUNC_L2_NORM, FUNC_H1_SEMINORM, FUNC_H1_NORM, \
+        FUNC_DER_LEFT, FUNC_DER_RIGHT, FUNC_L2_ERROR, FUNC_H1_SEMI_ERROR, \
+        FUNC_H1_ERROR
@@ -73,6 +73,8 @@ cdef extern from "hermes1d.h":
 
     # This is just the C++ "delete" statement
     void delete(...)
+    # and "delete []" for arrays allocated by new[]
+    void delete_array "delete []" (void *ptr)
 
     void throw_exception(char *msg)
 
@@ -90,20 +92,45 @@ cdef extern from "hermes1d.h":
         int *dof
 
     cdef struct c_Mesh "Mesh":
-        void create(double A, double B, int n)
-        int get_n_elems()
-        int get_n_dofs()
-        void set_poly_orders(int poly_order)
-        void assign_dofs()
-        c_Vertex *get_vertices()
-        c_Element *get_elems()
-        void set_dirichlet_bc_left(int eq_n, double val)
-        void set_dirichlet_bc_right(int eq_n, double val)
-    c_Mesh *new_Mesh "new Mesh" (int eq_num)
+        void create(double A, double B, int n) except +
+        int get_n_elems() except +
+        int get_n_dofs() except +
+        int get_n_eq() except +
+        void set_poly_orders(int poly_order) except +
+        void assign_dofs() except +
+        c_Vertex *get_vertices() except +
+        c_Element *get_elems() except +
+        void set_dirichlet_bc_left(int eq_n, double val) except +
+        void set_dirichlet_bc_right(int eq_n, double val) except +
+    c_Mesh *new_Mesh "new Mesh" (int eq_num) except +
 
     cdef struct c_Linearizer "Linearizer":
         void plot_solution(char *out_filename, double *y_prev,
-                int plotting_elem_subdivision)
+                int plotting_elem_subdivision) except +
         void get_xy(double *y_prev, int comp, int plotting_elem_subdivision,
-                double **x, double **y, int *n)
-    c_Linearizer *new_Linearizer "new Linearizer" (c_Mesh *mesh)
+                double **x, double **y, int *n) except +
+        int get_n_points(int plotting_elem_subdivision) except +
+        void eval_solution(double *y_prev, int plotting_elem_subdivision,
+                double *x, int x_stride, double *val, int pt_stride,
+                int comp_stride, double *der) except +
+    c_Linearizer *new_Linearizer "new Linearizer" (c_Mesh *mesh) except +
+
+    ctypedef void (*projection_fn)(double x, double *val, double *der,
+            void *user_data)
+
+    int c_FUNC_INTEGRAL "FUNC_INTEGRAL"
+    int c_FUNC_L2_NORM "FUNC_L2_NORM"
+    int c_FUNC_H1_SEMINORM "FUNC_H1_SEMINORM"
+    int c_FUNC_H1_NORM "FUNC_H1_NORM"
+    int c_FUNC_DER_LEFT "FUNC_DER_LEFT"
+    int c_FUNC_DER_RIGHT "FUNC_DER_RIGHT"
+    int c_FUNC_L2_ERROR "FUNC_L2_ERROR"
+    int c_FUNC_H1_SEMI_ERROR "FUNC_H1_SEMI_ERROR"
+    int c_FUNC_H1_ERROR "FUNC_H1_ERROR"
+
+    cdef struct c_Functionals "Functionals":
+        int add_builtin(int type, int comp, projection_fn exact,
+                void *exact_data) except +
+        int get_num() except +
+        void evaluate(double *y, double *results, int n_threads) nogil except +
+    c_Functionals *new_Functionals "new Functionals" (c_Mesh *mesh) except +
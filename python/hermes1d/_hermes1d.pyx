@@ -31,9 +31,15 @@ cdef class Mesh:
 
 cdef class Linearizer:
     cdef c_Linearizer *thisptr
+    # keeps the mesh alive as long as the linearizer
+    cdef Mesh mesh
 
     def __cinit__(self, Mesh mesh):
         self.thisptr = new_Linearizer(mesh.thisptr)
+        self.mesh = mesh
+
+    def __dealloc__(self):
+        delete(self.thisptr)
 
     def plot_solution(self, out_filename, y_prev, plotting_elem_subdivision):
         cdef double *A
@@ -57,8 +63,169 @@ cdef class Linearizer:
                 &x, &y, &n)
         x_numpy = c2numpy_double(x, n)
         y_numpy = c2numpy_double(y, n)
+        delete_array(x)
+        delete_array(y)
         return x_numpy, y_numpy
 
+    def eval_solution(self, y_prev, int plotting_elem_subdivision,
+            x=None, val=None, der=None, with_der=False):
+        """
+        Evaluates all solution components at the points of get_xy() in
+        one pass and returns (x, val, der): x has the shape (n,), val and
+        der the shape (n, n_eq), der is None unless it is given or
+        with_der is True.
+
+        Preallocated float64 arrays of these shapes (with any strides,
+        e.g. slices or transposed arrays) can be passed as x, val and
+        der; they are filled in place without copies.
+        """
+        from numpy import ascontiguousarray, empty, float64
+        cdef int n = self.thisptr.get_n_points(plotting_elem_subdivision)
+        cdef int n_eq = self.mesh.thisptr.get_n_eq()
+        cdef ndarray Y = ascontiguousarray(y_prev, dtype=float64)
+        if x is None:
+            x = empty(n, dtype=float64)
+        if val is None:
+            val = empty((n, n_eq), dtype=float64)
+        if der is None and with_der:
+            der = empty((n, n_eq), dtype=float64)
+        check_strided_buffer(x, (n,))
+        check_strided_buffer(val, (n, n_eq))
+        cdef ndarray X = x
+        cdef ndarray V = val
+        cdef ndarray D
+        cdef double *der_ptr = NULL
+        if der is not None:
+            check_strided_buffer(der, (n, n_eq))
+            if der.strides != val.strides:
+                raise ValueError("der must have the same strides as val")
+            D = der
+            der_ptr = <double *>D.data
+        self.thisptr.eval_solution(<double *>Y.data, plotting_elem_subdivision,
+                <double *>X.data, X.strides[0]/sizeof(double),
+                <double *>V.data, V.strides[0]/sizeof(double),
+                V.strides[1]/sizeof(double), der_ptr)
+        return x, val, der
+
+FUNC_INTEGRAL = c_FUNC_INTEGRAL
+FUNC_L2_NORM = c_FUNC_L2_NORM
+FUNC_H1_SEMINORM = c_FUNC_H1_SEMINORM
+FUNC_H1_NORM = c_FUNC_H1_NORM
+FUNC_DER_LEFT = c_FUNC_DER_LEFT
+FUNC_DER_RIGHT = c_FUNC_DER_RIGHT
+FUNC_L2_ERROR = c_FUNC_L2_ERROR
+FUNC_H1_SEMI_ERROR = c_FUNC_H1_SEMI_ERROR
+FUNC_H1_ERROR = c_FUNC_H1_ERROR
+
+cdef void exact_callback(double x, double *val, double *der,
+        void *data) with gil:
+    """
+    Calls the Python exact solution f(x) -> (val, der), two sequences of
+    length n_eq, stored as data = [f, n_eq, exc_info]. Exceptions cannot
+    pass through C++: the first one is stored as exc_info, the values are
+    set to NaN (f is not called any more) and Functionals.evaluate()
+    raises it.
+    """
+    d = <object>data
+    n_eq = d[1]
+    if d[2] is None:
+        try:
+            v, dv = d[0](x)
+            for c in range(n_eq):
+                val[c] = v[c]
+                der[c] = dv[c]
+            return
+        except:
+            d[2] = sys.exc_info()
+    nan = float("nan")
+    for c in range(n_eq):
+        val[c] = nan
+        der[c] = nan
+
+cdef class Functionals:
+    """
+    Evaluates norms, integrals, end point derivatives and error norms of
+    all solution components in one sweep over the elements, with the
+    element quadrature (see functional.h).
+
+    Example:
+
+    f = Functionals(mesh)
+    f.add_builtin(FUNC_L2_NORM, 0)
+    f.add_builtin(FUNC_H1_ERROR, 0, lambda x: ([sin(x)], [cos(x)]))
+    norm, err = f.evaluate(y)
+    """
+    cdef c_Functionals *thisptr
+    cdef Mesh mesh
+    # [f, n_eq, exc_info] lists passed to C++ as the exact solutions
+    cdef object exact_fns
+
+    def __cinit__(self, Mesh mesh):
+        self.thisptr = new_Functionals(mesh.thisptr)
+        self.mesh = mesh
+        self.exact_fns = []
+
+    def __dealloc__(self):
+        delete(self.thisptr)
+
+    def add_builtin(self, int type, int comp, exact=None):
+        """
+        Adds the functional 'type' (one of FUNC_*) of the component comp
+        and returns its index in the results of evaluate(). The error
+        norms need the exact solution exact(x) -> (val, der).
+        """
+        if exact is None:
+            return self.thisptr.add_builtin(type, comp, NULL, NULL)
+        data = None
+        for d in self.exact_fns:
+            if d[0] is exact:
+                data = d
+        if data is None:
+            data = [exact, self.mesh.thisptr.get_n_eq(), None]
+            self.exact_fns.append(data)
+        return self.thisptr.add_builtin(type, comp, exact_callback,
+                <void *>data)
+
+    def evaluate(self, y_prev, int n_threads=1):
+        """
+        Returns the array of the values of all functionals. An exception
+        raised by an exact solution is raised here.
+        """
+        from numpy import ascontiguousarray, empty, float64
+        cdef ndarray Y = ascontiguousarray(y_prev, dtype=float64)
+        cdef ndarray R = empty(self.thisptr.get_num(), dtype=float64)
+        cdef double *y_ptr = <double *>Y.data
+        cdef double *r_ptr = <double *>R.data
+        for d in self.exact_fns:
+            d[2] = None
+        with nogil:
+            self.thisptr.evaluate(y_ptr, r_ptr, n_threads)
+        exc_info = None
+        for d in self.exact_fns:
+            if d[2] is not None and exc_info is None:
+                exc_info = d[2]
+            d[2] = None
+        if exc_info is not None:
+            etype, value, tb = exc_info
+            raise etype, value, tb
+        return R
+
+def check_strided_buffer(A, shape):
+    """
+    Checks that A is a writable float64 array of the given shape whose
+    strides are multiples of sizeof(double), so that C++ can fill it.
+    """
+    from numpy import ndarray, float64
+    if not isinstance(A, ndarray) or A.dtype != float64:
+        raise TypeError("a float64 NumPy array is required")
+    if A.shape != shape:
+        raise ValueError("array of the shape %r required" % (shape,))
+    if not A.flags.writeable:
+        raise ValueError("the array is not writable")
+    for s in A.strides:
+        if s % sizeof(double) != 0:
+            raise ValueError("array strides must be multiples of 8 bytes")
+
 #-----------------------------------------------------------------------
 # Common C++ <-> Python+NumPy conversion tools:
 
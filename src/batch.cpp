@@ -0,0 +1,183 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <algorithm>
+#include <vector>
+#include <string>
+
+#include "batch.h"
+
+BatchSolver::BatchSolver(DiscreteProblem *dp, Solver **solvers, int n_threads)
+{
+  if (n_threads < 1) error("at least one thread needed in BatchSolver.");
+  for (int t=0; t < n_threads; t++)
+    if (solvers[t]->is_row_oriented()) 
+      error("row-oriented solvers are not supported by BatchSolver.");
+  this->dp = dp;
+  this->solvers = solvers;
+  this->n_threads = n_threads;
+  this->n_dof = dp->get_mesh()->get_n_dof();
+  this->newton_tol = 1e-8;
+  this->newton_max_iter = 50;
+  build_element_pattern(dp->get_mesh(), &this->nnz, &this->IA, &this->JA);
+  pthread_mutex_init(&this->lock, NULL);
+}
+
+BatchSolver::~BatchSolver()
+{
+  delete [] this->IA;
+  delete [] this->JA;
+  pthread_mutex_destroy(&this->lock);
+}
+
+void build_element_pattern(Mesh *mesh, int *nnz, int **IA, int **JA)
+{
+  Element *elems = mesh->get_elems();
+  int n_elem = mesh->get_n_elems();
+  int n_eq = mesh->get_n_eq();
+  int n = mesh->get_n_dof();
+
+  // all pairs of DOF of every element (all components are coupled)
+  std::vector< std::vector<int> > rows(n);
+  for (int m=0; m < n_elem; m++) {
+    std::vector<int> dofs;
+    for (int c=0; c < n_eq; c++)
+      for (int j=0; j <= elems[m].p; j++)
+        if (elems[m].dof[c][j] != -1) dofs.push_back(elems[m].dof[c][j]);
+    for (int a=0; a < dofs.size(); a++)
+      for (int b=0; b < dofs.size(); b++) rows[dofs[a]].push_back(dofs[b]);
+  }
+  int *ia = new int[n+1];
+  ia[0] = 0;
+  for (int i=0; i < n; i++) {
+    std::sort(rows[i].begin(), rows[i].end());
+    rows[i].erase(std::unique(rows[i].begin(), rows[i].end()), rows[i].end());
+    ia[i+1] = ia[i] + rows[i].size();
+  }
+  int *ja = new int[ia[n] > 0 ? ia[n] : 1];
+  for (int i=0; i < n; i++)
+    for (int k=0; k < rows[i].size(); k++) ja[ia[i] + k] = rows[i][k];
+  *nnz = ia[n];
+  *IA = ia;
+  *JA = ja;
+}
+
+int BatchSolver::solve_instance(Solver *solver, void *ctx, CSRMatrix *mat, double *res,
+                                double *vec, ProblemInstance *inst, double *y)
+{
+  int n = this->n_dof;
+  for (int it=0; ; it++) {
+    mat->zero();
+    this->dp->assemble_matrix_and_vector(mat, res, y, inst);
+    double res_norm = 0;
+    for (int i=0; i < n; i++) res_norm += res[i]*res[i];
+    res_norm = sqrt(res_norm);
+    if (res_norm < this->newton_tol) return it;
+    if (it >= this->newton_max_iter) return -1;
+
+    for (int i=0; i < n; i++) res[i] *= -1;
+    if (!solver->factorize(ctx, n, mat->get_IA(), mat->get_JA(), mat->get_A(), false))
+      return -1;
+    if (!solver->solve(ctx, n, mat->get_IA(), mat->get_JA(), mat->get_A(), false, res, vec))
+      return -1;
+    for (int i=0; i < n; i++) y[i] += vec[i];
+  }
+}
+
+void BatchSolver::run_worker(int t)
+{
+  int n = this->n_dof;
+  Solver *solver = this->solvers[t];
+  void *ctx = solver->new_context(false);
+  CSRMatrix mat(n, this->nnz, this->IA, this->JA);
+  double *res = new double[n];
+  double *vec = new double[n];
+  // the pattern is the same for all instances
+  bool analyzed = solver->analyze(ctx, n, mat.get_IA(), mat.get_JA(), mat.get_A(), false);
+
+  while (1) {
+    pthread_mutex_lock(&this->lock);
+    int k = this->next_inst++;
+    pthread_mutex_unlock(&this->lock);
+    if (k >= this->n_inst) break;
+
+    int it = -1;
+    // an error in one instance (e.g. a singular matrix) does not stop the others
+    try {
+      if (analyzed) 
+        it = this->solve_instance(solver, ctx, &mat, res, vec, this->inst + k, this->y[k]);
+    }
+    catch (std::runtime_error &e) {
+      it = -1;
+    }
+    if (this->iters != NULL) this->iters[k] = it;
+    if (it < 0) {
+      pthread_mutex_lock(&this->lock);
+      this->n_failed++;
+      pthread_mutex_unlock(&this->lock);
+    }
+  }
+
+  solver->free_data(ctx);
+  solver->free_context(ctx);
+  delete [] res;
+  delete [] vec;
+}
+
+struct BatchWorkerData {
+  BatchSolver *batch;
+  int t;
+};
+
+void *BatchSolver::worker(void *data)
+{
+  BatchWorkerData *d = (BatchWorkerData *) data;
+  d->batch->run_worker(d->t);
+  return NULL;
+}
+
+int BatchSolver::solve(int n_inst, ProblemInstance *inst, double **y, int *iters)
+{
+  if (n_inst <= 0) return 0;
+  this->n_inst = n_inst;
+  this->inst = inst;
+  this->y = y;
+  this->iters = iters;
+  this->next_inst = 0;
+  this->n_failed = 0;
+
+  // one serial assembly fills the cache of the FORM_CONST forms, which
+  // is then only read by the threads
+  CSRMatrix mat(this->n_dof, this->nnz, this->IA, this->JA);
+  this->dp->assemble_matrix(&mat, y[0], inst);
+
+  int n_threads = (this->n_threads < n_inst) ? this->n_threads : n_inst;
+  pthread_t *threads = new pthread_t[n_threads];
+  BatchWorkerData *data = new BatchWorkerData[n_threads];
+  int n_started = 0;
+  for (int t=0; t < n_threads; t++) {
+    data[t].batch = this;
+    data[t].t = t;
+    if (pthread_create(&threads[t], NULL, BatchSolver::worker, &data[t]) != 0) break;
+    n_started++;
+  }
+  // if a thread cannot be created, the calling thread takes its place
+  // (with its solver), the instances are shared by all workers
+  std::string msg;
+  if (n_started < n_threads) {
+    try {
+      this->run_worker(n_started);
+    }
+    catch (std::runtime_error &e) {
+      msg = e.what();
+    }
+  }
+  for (int t=0; t < n_started; t++) pthread_join(threads[t], NULL);
+  delete [] threads;
+  delete [] data;
+  if (!msg.empty()) error(msg.c_str());
+
+  return this->n_failed;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_BATCH_H
+#define __HERMES1D_BATCH_H
+
+#include <pthread.h>
+
+#include "common.h"
+#include "matrix.h"
+#include "solver.h"
+#include "discrete.h"
+
+/// Sparsity pattern containing all pairs of DOF of every element of the
+/// mesh (all solution components coupled), with sorted column indices.
+/// It covers every matrix assembled by DiscreteProblem, whatever the
+/// values. The arrays IA (length n_dof+1) and JA (length nnz) are
+/// allocated by new[].
+void build_element_pattern(Mesh *mesh, int *nnz, int **IA, int **JA);
+
+/// Solves many instances of one stationary problem (see ProblemInstance)
+/// by Newton's method. All instances share the DiscreteProblem with its
+/// mesh, DOF numbering, forms and quadrature and shape function tables,
+/// and one sparsity pattern of the Jacobi matrix, which contains all DOF
+/// pairs of every element, so it does not depend on the values. The
+/// instances are solved concurrently on n_threads threads; thread t uses
+/// solvers[t] and analyzes the pattern only once for all its instances.
+///
+/// The forms must be reentrant (they may only read global data and the
+/// user data of their instance).
+class BatchSolver {
+public:
+    BatchSolver(DiscreteProblem *dp, Solver **solvers, int n_threads);
+    ~BatchSolver();
+
+    void set_newton(double tol, int max_iter) {
+        this->newton_tol = tol;
+        this->newton_max_iter = max_iter;
+    }
+
+    // Solves the instances inst[0], ..., inst[n_inst-1]. On input, y[k]
+    // (length n_dof) is the initial guess of the instance k, on output
+    // its solution. If iters is not NULL, iters[k] returns the number of
+    // Newton iterations, or -1 if Newton's method did not converge.
+    // Returns the number of instances that did not converge.
+    int solve(int n_inst, ProblemInstance *inst, double **y, int *iters=NULL);
+
+    int get_nnz() {
+        return this->nnz;
+    }
+
+private:
+    DiscreteProblem *dp;
+    Solver **solvers;
+    int n_threads;
+    int n_dof;
+    double newton_tol;
+    int newton_max_iter;
+
+    // sparsity pattern of the Jacobi matrix (in the DiscreteProblem
+    // storage, i.e. compressed columns)
+    int nnz;
+    int *IA, *JA;
+
+    // instances being solved and the next one to be taken by a thread
+    int n_inst;
+    ProblemInstance *inst;
+    double **y;
+    int *iters;
+    int next_inst;
+    int n_failed;
+    pthread_mutex_t lock;
+
+    // Newton's method for one instance, returns the number of iterations
+    // or -1
+    int solve_instance(Solver *solver, void *ctx, CSRMatrix *mat, double *res,
+                       double *vec, ProblemInstance *inst, double *y);
+    static void *worker(void *data);
+    void run_worker(int t);
+};
+
+#endif
@@ -0,0 +1,217 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+static const char CHECKPOINT_MAGIC[8] = "H1DCKPT";
+static const uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+
+static uint64_t align_offset(uint64_t offset)
+{
+  return (offset + CHECKPOINT_ALIGNMENT - 1)/CHECKPOINT_ALIGNMENT*CHECKPOINT_ALIGNMENT;
+}
+
+// writes 'size' bytes at the position 'offset' (>= current position),
+// the gap is filled with zeros
+static void write_section(FILE *f, uint64_t *pos,
+                          uint64_t offset, const void *data, size_t size)
+{
+  static const char zeros[CHECKPOINT_ALIGNMENT] = {0};
+  if (fwrite(zeros, 1, offset - *pos, f) != offset - *pos ||
+      fwrite(data, 1, size, f) != size)
+    error("problem writing checkpoint file.");
+  *pos = offset + size;
+}
+
+void save_checkpoint(const char *filename, Mesh *mesh, double *y)
+{
+  int n_eq = mesh->get_n_eq();
+  int n_elem = mesh->get_n_elems();
+  Element *elems = mesh->get_elems();
+  Vertex *vertices = mesh->get_vertices();
+
+  // contiguous copies of the mesh data
+  double *x = new double[n_elem+1];
+  int32_t *degrees = new int32_t[n_elem];
+  int64_t *dof_ptr = new int64_t[n_elem+1];
+  for (int i=0; i<n_elem+1; i++) x[i] = vertices[i].x;
+  dof_ptr[0] = 0;
+  for (int m=0; m<n_elem; m++) {
+    degrees[m] = elems[m].p;
+    dof_ptr[m+1] = dof_ptr[m] + n_eq*(elems[m].p + 1);
+  }
+  int64_t n_dof_map = dof_ptr[n_elem];
+  int32_t *dof_map = new int32_t[n_dof_map];
+  for (int m=0; m<n_elem; m++)
+    for (int c=0; c<n_eq; c++)
+      for (int k=0; k<=elems[m].p; k++)
+        dof_map[dof_ptr[m] + c*(elems[m].p + 1) + k] = elems[m].dof[c][k];
+  int32_t *bc_flags = new int32_t[2*n_eq];
+  double *bc_values = new double[2*n_eq];
+  for (int c=0; c<n_eq; c++) {
+    bc_flags[c] = mesh->bc_left_dir[c];
+    bc_flags[n_eq + c] = mesh->bc_right_dir[c];
+    bc_values[c] = mesh->bc_left_dir_values[c];
+    bc_values[n_eq + c] = mesh->bc_right_dir_values[c];
+  }
+
+  const void *data[CKPT_N_SECTIONS] = {x, degrees, dof_ptr, dof_map,
+                                       bc_flags, bc_values, y};
+  size_t size[CKPT_N_SECTIONS] = {
+    (n_elem + 1)*sizeof(double), n_elem*sizeof(int32_t),
+    (n_elem + 1)*sizeof(int64_t), n_dof_map*sizeof(int32_t),
+    2*n_eq*sizeof(int32_t), 2*n_eq*sizeof(double),
+    mesh->get_n_dof()*sizeof(double)
+  };
+
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.byte_order = CHECKPOINT_BYTE_ORDER;
+  header.n_eq = n_eq;
+  header.n_elem = n_elem;
+  header.n_dof = mesh->get_n_dof();
+  header.n_dof_map = n_dof_map;
+  uint64_t offset = sizeof(header);
+  for (int k=0; k<CKPT_N_SECTIONS; k++) {
+    offset = align_offset(offset);
+    header.offsets[k] = offset;
+    offset += size[k];
+  }
+
+  FILE *f = fopen(filename, "wb");
+  if (f == NULL) error("problem opening checkpoint file.");
+  uint64_t pos = 0;
+  write_section(f, &pos, 0, &header, sizeof(header));
+  for (int k=0; k<CKPT_N_SECTIONS; k++)
+    write_section(f, &pos, header.offsets[k], data[k], size[k]);
+  if (fclose(f) != 0) error("problem writing checkpoint file.");
+
+  delete [] x;
+  delete [] degrees;
+  delete [] dof_ptr;
+  delete [] dof_map;
+  delete [] bc_flags;
+  delete [] bc_values;
+}
+
+Checkpoint::Checkpoint(const char *filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) error("problem opening checkpoint file.");
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CheckpointHeader)) {
+    close(fd);
+    error("checkpoint file too short.");
+  }
+  this->size = st.st_size;
+  // private writable mapping: pages are copied only when written to
+  void *ptr = mmap(NULL, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) error("cannot map checkpoint file into memory.");
+  this->data = (char *) ptr;
+  this->header = (CheckpointHeader *) ptr;
+
+  const char *msg = this->validate();
+  if (msg != NULL) {
+    munmap(this->data, this->size);
+    error(msg);
+  }
+}
+
+// Checks the header and the sections, so that a corrupt or truncated
+// file is never read outside of the mapping. Returns NULL if the file
+// is valid, or the error message.
+const char *Checkpoint::validate()
+{
+  CheckpointHeader *h = this->header;
+  if (memcmp(h->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+    return "not a checkpoint file.";
+  if (h->byte_order != CHECKPOINT_BYTE_ORDER)
+    return "checkpoint file written with a different byte order.";
+  if (h->version != CHECKPOINT_VERSION)
+    return "unsupported checkpoint file version.";
+  if (h->n_eq < 1 || h->n_eq > MAX_EQN_NUM || h->n_elem < 1 || h->n_dof < 0 || 
+      h->n_dof > INT32_MAX || h->n_dof_map < 0 || (uint64_t) h->n_dof_map > this->size)
+    return "invalid sizes in checkpoint file.";
+
+  uint64_t n_elem = h->n_elem, n_eq = h->n_eq;
+  uint64_t size[CKPT_N_SECTIONS] = {
+    (n_elem + 1)*sizeof(double), n_elem*sizeof(int32_t),
+    (n_elem + 1)*sizeof(int64_t), h->n_dof_map*sizeof(int32_t),
+    2*n_eq*sizeof(int32_t), 2*n_eq*sizeof(double), h->n_dof*sizeof(double)
+  };
+  for (int k=0; k<CKPT_N_SECTIONS; k++) {
+    if (h->offsets[k] % CHECKPOINT_ALIGNMENT != 0 || h->offsets[k] < sizeof(CheckpointHeader))
+      return "misaligned section in checkpoint file.";
+    if (h->offsets[k] > this->size || size[k] > this->size - h->offsets[k])
+      return "checkpoint file truncated.";
+  }
+
+  // element degrees and DOF map
+  int *degrees = this->get_degrees();
+  int64_t *dof_ptr = this->get_dof_ptr();
+  int *dof_map = this->get_dof_map();
+  if (dof_ptr[0] != 0) return "invalid DOF map in checkpoint file.";
+  for (int m=0; m<h->n_elem; m++) {
+    if (degrees[m] < 1 || degrees[m] > MAX_P) 
+      return "invalid element degree in checkpoint file.";
+    if (dof_ptr[m+1] - dof_ptr[m] != h->n_eq*(degrees[m] + 1))
+      return "invalid DOF map in checkpoint file.";
+  }
+  if (dof_ptr[h->n_elem] != h->n_dof_map) return "invalid DOF map in checkpoint file.";
+  for (int64_t i=0; i<h->n_dof_map; i++)
+    if (dof_map[i] < -1 || dof_map[i] >= h->n_dof) 
+      return "invalid DOF map in checkpoint file.";
+  return NULL;
+}
+
+Checkpoint::~Checkpoint()
+{
+  munmap(this->data, this->size);
+}
+
+Mesh *Checkpoint::create_mesh()
+{
+  int n_eq = this->get_n_eq();
+  int n_elem = this->get_n_elems();
+  double *x = this->get_vertices();
+  Mesh *mesh = new Mesh(n_eq);
+  mesh->create(x[0], x[n_elem], n_elem);
+  Vertex *vertices = mesh->get_vertices();
+  for (int i=0; i<n_elem+1; i++) vertices[i].x = x[i];
+  mesh->set_poly_orders(this->get_degrees());
+  int *bc_flags = this->get_bc_flags();
+  double *bc_values = this->get_bc_values();
+  for (int c=0; c<n_eq; c++) {
+    if (bc_flags[c]) mesh->set_bc_left_dirichlet(c, bc_values[c]);
+    if (bc_flags[n_eq + c]) mesh->set_bc_right_dirichlet(c, bc_values[n_eq + c]);
+  }
+  mesh->assign_dofs();
+
+  // the coefficients are only meaningful with the same DOF numbering
+  Element *elems = mesh->get_elems();
+  int64_t *dof_ptr = this->get_dof_ptr();
+  int *dof_map = this->get_dof_map();
+  bool match = (mesh->get_n_dof() == this->get_n_dof());
+  for (int m=0; m<n_elem && match; m++)
+    for (int c=0; c<n_eq; c++)
+      for (int k=0; k<=elems[m].p; k++)
+        if (dof_map[dof_ptr[m] + c*(elems[m].p + 1) + k] != elems[m].dof[c][k])
+          match = false;
+  if (!match) {
+    delete mesh;
+    error("DOF numbering in the checkpoint does not match the mesh.");
+  }
+  return mesh;
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_CHECKPOINT_H
+#define __HERMES1D_CHECKPOINT_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "mesh.h"
+
+const int CHECKPOINT_VERSION = 1;
+// sections start at multiples of CHECKPOINT_ALIGNMENT bytes
+const int CHECKPOINT_ALIGNMENT = 64;
+
+// sections of a checkpoint file
+#define CKPT_VERTICES 0    // double[n_elem+1], vertex coordinates
+#define CKPT_DEGREES 1     // int32[n_elem], polynomial degrees
+#define CKPT_DOF_PTR 2     // int64[n_elem+1], start of every element in CKPT_DOF_MAP
+#define CKPT_DOF_MAP 3     // int32[], dof[c][k] of the element m at dof_ptr[m] + c*(p+1) + k
+#define CKPT_BC_FLAGS 4    // int32[2*n_eq], bc_left_dir, bc_right_dir
+#define CKPT_BC_VALUES 5   // double[2*n_eq], bc_left_dir_values, bc_right_dir_values
+#define CKPT_COEFFS 6      // double[n_dof], solution coefficients
+#define CKPT_N_SECTIONS 7
+
+/// Header at the beginning of a checkpoint file. All numbers are in the
+/// byte order of the writing machine, byte_order = 0x01020304 tells it.
+struct CheckpointHeader {
+    char magic[8];          // "H1DCKPT"
+    uint32_t version;       // CHECKPOINT_VERSION
+    uint32_t byte_order;
+    int32_t n_eq;
+    int32_t n_elem;
+    int64_t n_dof;
+    int64_t n_dof_map;      // length of the CKPT_DOF_MAP section
+    uint64_t offsets[CKPT_N_SECTIONS];  // byte offsets of the sections
+};
+
+/// Saves the mesh (vertices, degrees, DOF numbering, Dirichlet conditions)
+/// and the solution y (length n_dof) to a checkpoint file. Every section
+/// is one contiguous, aligned array.
+void save_checkpoint(const char *filename, Mesh *mesh, double *y);
+
+/// Checkpoint file mapped into memory by mmap(): the sections are
+/// accessed in place, without reading or copying, so opening a large
+/// checkpoint takes only as long as the mmap() call. The mapping is
+/// private, so the arrays may be modified (e.g. the coefficients used as
+/// the solution vector of a restarted run) without changing the file;
+/// the pages touched are copied on write. The constructor checks the
+/// sizes, offsets and alignment of all sections, the degrees and the DOF
+/// map, and reports a corrupt or truncated file by error().
+class Checkpoint {
+public:
+    Checkpoint(const char *filename);
+    ~Checkpoint();
+
+    int get_n_eq() {
+        return this->header->n_eq;
+    }
+    int get_n_elems() {
+        return this->header->n_elem;
+    }
+    int get_n_dof() {
+        return this->header->n_dof;
+    }
+    double *get_vertices() {
+        return (double *) this->section(CKPT_VERTICES);
+    }
+    int *get_degrees() {
+        return (int *) this->section(CKPT_DEGREES);
+    }
+    int64_t *get_dof_ptr() {
+        return (int64_t *) this->section(CKPT_DOF_PTR);
+    }
+    int *get_dof_map() {
+        return (int *) this->section(CKPT_DOF_MAP);
+    }
+    int *get_bc_flags() {
+        return (int *) this->section(CKPT_BC_FLAGS);
+    }
+    double *get_bc_values() {
+        return (double *) this->section(CKPT_BC_VALUES);
+    }
+    // valid as long as the Checkpoint exists
+    double *get_coeffs() {
+        return (double *) this->section(CKPT_COEFFS);
+    }
+
+    // Creates a new Mesh with the saved vertices, degrees and boundary
+    // conditions. Its DOF numbering is checked against the saved one, so
+    // get_coeffs() can be used with it directly.
+    Mesh *create_mesh();
+
+private:
+    CheckpointHeader *header;
+    char *data;
+    size_t size;
+    char *section(int k) {
+        return this->data + this->header->offsets[k];
+    }
+    const char *validate();
+};
+
+#endif
@@ -3,12 +3,13 @@
 // file for the exact terms).
 // Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
 
+#include <time.h>
+
 #include "common.h"
 
 void error(const char *msg)
 {
-  printf("Error: %s\n", msg);
-  exit(0);
+  throw std::runtime_error(msg);
 };
 
 void intro() {
@@ -26,6 +27,13 @@ void throw_exception(char *text)
     throw std::runtime_error(text);
 }
 
+double get_wall_time()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
 double **dmalloc(int n_eq) {
     double **pointer = (double**)malloc(n_eq*sizeof(double*));
     if(pointer == NULL) error("dmalloc failed.");
@@ -24,6 +24,8 @@ const int MAX_P = 50;                  // this is the maximum polynomial degree
 const int MAX_COEFFS_NUM = MAX_P + 1;  // this is the maximum polynomial degree allowed in elements
 const int MAX_STRING_LENGTH = 100;     // maximum string length 
 
+// Reports an error by throwing std::runtime_error(msg), so that a failed
+// solve does not terminate other solves running in the same process.
 void error(const char *msg);
 
 typedef double scalar;
@@ -38,11 +40,14 @@ void intro();
 
 void throw_exception(char *text);
 
-#define MEM_CHECK(var) if (var == NULL) { printf("Out of memory."); exit(1); }
+#define MEM_CHECK(var) if (var == NULL) error("Out of memory.");
 
 #define verbose(msg)
 #define warn(msg)
 
+// wall clock time in seconds, for measuring elapsed times
+double get_wall_time();
+
 double **dmalloc(int n_eq);
    
 int **imalloc(int n_eq);
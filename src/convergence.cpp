@@ -0,0 +1,188 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <math.h>
+#include <vector>
+
+#include "convergence.h"
+#include "batch.h"
+#include "nested.h"
+#include "functional.h"
+
+// solution y on the mesh 'mesh', as the exact solution of the study
+struct ReferenceSolution {
+  Mesh *mesh;
+  double *y;
+};
+
+// Squared L2 and H1 errors of the solution y on 'mesh' with respect to
+// the reference solution, and the squared H1 norm of y, summed over all
+// components. Both solutions are polynomials on the overlaps of the
+// elements of the two meshes (found by a merge pass as in
+// transfer_solution()), so integrating over each overlap with the Gauss
+// rule of order 2 max(p, p_ref) is exact, also where the elements of
+// the meshes do not match.
+static void reference_errors(Mesh *mesh, double *y, ReferenceSolution *ref,
+                             double *err_l2, double *err_h1, double *norm_h1)
+{
+  int n_eq = mesh->get_n_eq();
+  Element *elems = mesh->get_elems();
+  Element *ref_elems = ref->mesh->get_elems();
+  int n_elem = mesh->get_n_elems();
+  int n_ref = ref->mesh->get_n_elems();
+  double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  double ref_coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  double val[MAX_EQN_NUM], der[MAX_EQN_NUM];
+  double ref_val[MAX_EQN_NUM], ref_der[MAX_EQN_NUM];
+  *err_l2 = *err_h1 = *norm_h1 = 0;
+  // j is the first reference element overlapping the element m
+  int j = 0, j_coeffs = -1;
+  for (int m=0; m < n_elem; m++) {
+    Element *e = elems + m;
+    double a = e->v1->x, b = e->v2->x;
+    double eps = 1e-12*(b - a);
+    while (j < n_ref - 1 && ref_elems[j].v2->x <= a + eps) j++;
+    mesh->calculate_elem_coeffs(m, y, coeffs);
+    for (int k=j; k < n_ref; k++) {
+      Element *re = ref_elems + k;
+      double sa = re->v1->x, sb = re->v2->x;
+      if (sa >= b - eps) break;
+      double lo = (sa > a) ? sa : a;
+      double hi = (sb < b) ? sb : b;
+      if (hi <= lo) continue;
+      if (k != j_coeffs) {
+        ref->mesh->calculate_elem_coeffs(k, ref->y, ref_coeffs);
+        j_coeffs = k;
+      }
+      int order = 2*((e->p > re->p) ? e->p : re->p);
+      if (order > g_quad_1d_std.get_max_order()) 
+        error("element degree too high in run_convergence_study().");
+      double *pts = g_quad_1d_std.get_points(order);
+      double *weights = g_quad_1d_std.get_weights(order);
+      int num = g_quad_1d_std.get_num_points(order);
+      for (int i=0; i < num; i++) {
+        double x = (hi - lo)/2*pts[i] + (hi + lo)/2;
+        double w = weights[i]*(hi - lo)/2;
+        mesh->element_solution_point((2*x - a - b)/(b - a), e, coeffs, val, der);
+        ref->mesh->element_solution_point((2*x - sa - sb)/(sb - sa), re, ref_coeffs, 
+                                          ref_val, ref_der);
+        for (int c=0; c < n_eq; c++) {
+          double du = val[c] - ref_val[c], dd = der[c] - ref_der[c];
+          *err_l2 += du*du*w;
+          *err_h1 += (du*du + dd*dd)*w;
+          *norm_h1 += (val[c]*val[c] + der[c]*der[c])*w;
+        }
+      }
+    }
+  }
+}
+
+// uniform mesh of the problem with the DOFs assigned
+static void init_mesh(ConvergenceProblem *problem, Mesh *mesh, int n_elem, int p)
+{
+  mesh->create(problem->a, problem->b, n_elem);
+  mesh->set_uniform_poly_order(p);
+  if (problem->set_bc != NULL) problem->set_bc(mesh, problem->user_data);
+  mesh->assign_dofs();
+}
+
+// solves the problem on 'mesh' from zero, y has n_dof entries
+static int solve(ConvergenceProblem *problem, Mesh *mesh, Solver *solver, double *y,
+                 double tol, int max_iter, double *assembly_time, double *solve_time)
+{
+  DiscreteProblem dp(mesh);
+  problem->add_forms(&dp, problem->user_data);
+  for (int i=0; i < mesh->get_n_dof(); i++) y[i] = 0;
+  return solve_newton(&dp, solver, y, tol, max_iter, assembly_time, solve_time);
+}
+
+void run_convergence_study(ConvergenceProblem *problem, Solver *solver,
+                           int n_meshes, int *n_elems, int n_degrees, int *degrees,
+                           ConvergenceResult *results, double tol, int max_iter)
+{
+  if (solver->is_row_oriented()) 
+    error("row-oriented solvers are not supported by run_convergence_study().");
+  int n_eq = problem->n_eq;
+
+  // the meshes and the solutions are released also if an error is thrown
+  Mesh ref_mesh(n_eq);
+  std::vector<double> ref_y;
+  ReferenceSolution ref;
+  ref.mesh = NULL;
+  ref.y = NULL;
+  if (problem->exact == NULL) {
+    init_mesh(problem, &ref_mesh, problem->ref_n_elem, problem->ref_p);
+    ref_y.resize(ref_mesh.get_n_dof());
+    ref.mesh = &ref_mesh;
+    ref.y = &ref_y[0];
+    if (solve(problem, ref.mesh, solver, ref.y, tol, max_iter, NULL, NULL) < 0)
+      error("Newton's method did not converge for the reference solution.");
+  }
+
+  for (int i=0; i < n_meshes; i++) {
+    for (int j=0; j < n_degrees; j++) {
+      ConvergenceResult *r = results + i*n_degrees + j;
+      Mesh mesh(n_eq);
+      init_mesh(problem, &mesh, n_elems[i], degrees[j]);
+      r->n_elem = n_elems[i];
+      r->p = degrees[j];
+      r->n_dof = mesh.get_n_dof();
+      int *IA, *JA;
+      build_element_pattern(&mesh, &r->nnz, &IA, &JA);
+      delete [] IA;
+      delete [] JA;
+
+      std::vector<double> y(r->n_dof);
+      r->assembly_time = r->solve_time = 0;
+      r->newton_iters = solve(problem, &mesh, solver, &y[0], tol, max_iter, 
+                              &r->assembly_time, &r->solve_time);
+
+      double l2 = 0, h1 = 0, u_h1 = 0;
+      if (ref.mesh != NULL) 
+        reference_errors(&mesh, &y[0], &ref, &l2, &h1, &u_h1);
+      else {
+        // all error norms in one pass
+        Functionals f(&mesh);
+        for (int c=0; c < n_eq; c++) {
+          f.add_builtin(FUNC_L2_ERROR, c, problem->exact, problem->exact_data);
+          f.add_builtin(FUNC_H1_ERROR, c, problem->exact, problem->exact_data);
+          f.add_builtin(FUNC_H1_NORM, c);
+        }
+        double norms[3*MAX_EQN_NUM];
+        f.evaluate(&y[0], norms);
+        for (int c=0; c < n_eq; c++) {
+          l2 += norms[3*c]*norms[3*c];
+          h1 += norms[3*c+1]*norms[3*c+1];
+          u_h1 += norms[3*c+2]*norms[3*c+2];
+        }
+      }
+      r->err_l2 = sqrt(l2);
+      r->err_h1 = sqrt(h1);
+      r->rel_err_h1 = (u_h1 > 0) ? sqrt(h1/u_h1) : 0;
+    }
+  }
+}
+
+void write_convergence_table(const char *filename, ConvergenceResult *results, int n)
+{
+  FILE *f = stdout;
+  if (filename != NULL) {
+    f = fopen(filename, "w");
+    if (f == NULL) error("problem opening file in write_convergence_table().");
+  }
+  fprintf(f, "# %6s %4s %8s %9s %6s %12s %12s %12s %12s %12s\n", "n_elem", "p", 
+          "n_dof", "nnz", "iters", "t_assembly", "t_solve", "err_l2", "err_h1", 
+          "rel_err_h1");
+  for (int i=0; i < n; i++) {
+    ConvergenceResult *r = results + i;
+    fprintf(f, "  %6d %4d %8d %9d %6d %12.4e %12.4e %12.4e %12.4e %12.4e\n", 
+            r->n_elem, r->p, r->n_dof, r->nnz, r->newton_iters, r->assembly_time, 
+            r->solve_time, r->err_l2, r->err_h1, r->rel_err_h1);
+  }
+  if (filename != NULL) {
+    fclose(f);
+    printf("Output written to %s.\n", filename);
+  }
+}
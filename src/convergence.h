@@ -0,0 +1,65 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_CONVERGENCE_H
+#define __HERMES1D_CONVERGENCE_H
+
+#include "common.h"
+#include "solver.h"
+#include "mesh.h"
+#include "discrete.h"
+#include "transfer.h"
+
+/// Stationary problem for run_convergence_study(). For every
+/// discretization a new Mesh over (a, b) is created, set_bc() sets its
+/// boundary conditions (before the DOFs are assigned) and add_forms()
+/// registers the forms of a new DiscreteProblem on it.
+///
+/// The errors are measured against the exact solution 'exact' (values
+/// and derivatives of all components, see projection_fn) or, if it is
+/// NULL, against a reference solution computed once on a uniform mesh of
+/// ref_n_elem elements of degree ref_p. The errors against the reference
+/// solution are integrated over the overlaps of the elements of the two
+/// meshes, so they are exact (up to rounding) also when the meshes are
+/// not nested.
+struct ConvergenceProblem {
+    int n_eq;
+    double a, b;
+    void (*set_bc)(Mesh *mesh, void *user_data);
+    void (*add_forms)(DiscreteProblem *dp, void *user_data);
+    void *user_data;
+    projection_fn exact;
+    void *exact_data;
+    int ref_n_elem, ref_p;
+};
+
+/// One row of the convergence study.
+struct ConvergenceResult {
+    int n_elem, p;
+    int n_dof, nnz;          // unknowns and nonzeros of the Jacobi matrix
+    int newton_iters;        // -1 if Newton's method did not converge
+    double assembly_time;    // wall clock seconds of all assemblies
+    double solve_time;       // and of all linear solves
+    double err_l2, err_h1;   // error norms over all components
+    double rel_err_h1;       // err_h1 relative to the H1 norm of the solution
+};
+
+/// Convergence study of the problem on uniform meshes: the problem is
+/// solved by Newton's method (solve_newton(), from zero) for every number
+/// of elements n_elems[i] and every degree degrees[j], so a single sweep
+/// covers h-refinement (the rows of one degree), p-refinement (the rows
+/// of one mesh) and their combinations. results (n_meshes*n_degrees
+/// entries) returns the row of (n_elems[i], degrees[j]) at i*n_degrees + j.
+void run_convergence_study(ConvergenceProblem *problem, Solver *solver,
+                           int n_meshes, int *n_elems, int n_degrees, int *degrees,
+                           ConvergenceResult *results, double tol=1e-8, 
+                           int max_iter=50);
+
+/// Writes the results as a table with one line per discretization and a
+/// commented header (readable by gnuplot), to stdout if filename is NULL.
+void write_convergence_table(const char *filename, ConvergenceResult *results, 
+                             int n);
+
+#endif
@@ -3,22 +3,47 @@
 // file for the exact terms).
 // Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
 
+#include <pthread.h>
+#include <string>
+
 #include "discrete.h"
 
 DiscreteProblem::DiscreteProblem(Mesh *mesh)
 {
     this->mesh = mesh;
+    this->const_cache_valid = false;
+    this->const_cache_revision = -1;
 }
 
-void DiscreteProblem::add_matrix_form(int i, int j, matrix_form fn)
+void DiscreteProblem::set_mesh(Mesh *mesh)
 {
-    MatrixFormVol form = {i, j, fn};
+    if (mesh->get_n_eq() != this->mesh->get_n_eq())
+        error("different number of equations in DiscreteProblem::set_mesh().");
+    for (int k = 0; k < this->operator_forms.size(); k++)
+        if (this->operator_forms[k].elem_coeffs != NULL)
+            error("elementwise operator coefficients in DiscreteProblem::set_mesh().");
+    this->mesh = mesh;
+    this->invalidate_cache();
+}
+
+void DiscreteProblem::add_matrix_form(int i, int j, matrix_form fn, int flags,
+                                      int order_mult, int order_add)
+{
+    MatrixFormVol form = {i, j, fn, flags, order_mult, order_add};
     this->matrix_forms_vol.push_back(form);
+    if (flags & FORM_CONST) this->invalidate_cache();
 }
 
-void DiscreteProblem::add_vector_form(int i, vector_form fn)
+void DiscreteProblem::invalidate_cache()
 {
-    VectorFormVol form = {i, fn};
+    this->const_cache.clear();
+    this->const_cache_valid = false;
+}
+
+void DiscreteProblem::add_vector_form(int i, vector_form fn, int flags,
+                                      int order_mult, int order_add)
+{
+    VectorFormVol form = {i, fn, flags, order_mult, order_add};
     this->vector_forms_vol.push_back(form);
 }
 
@@ -34,150 +59,248 @@ void DiscreteProblem::add_vector_form_surf(int i, vector_form_surf fn, int bdy_i
     this->vector_forms_surf.push_back(form);
 }
 
+void DiscreteProblem::add_operator(int i, int j, int op, double coeff)
+{
+    OperatorForm form = {i, j, op, coeff, NULL};
+    this->operator_forms.push_back(form);
+}
+
+void DiscreteProblem::add_operator(int i, int j, int op, double *elem_coeffs)
+{
+    OperatorForm form = {i, j, op, 0, elem_coeffs};
+    this->operator_forms.push_back(form);
+}
+
+// quadrature selected by the form flags
+static Quad1D *form_quad(int flags)
+{
+  if(flags & FORM_QUAD_LOBATTO) return &g_quad_1d_lobatto;
+  return &g_quad_1d_std;
+}
+
+// quadrature order order_mult*p + order_add of a form in an element of degree p
+static int quad_order(int order_mult, int order_add, int p, Quad1D *quad)
+{
+  int order = order_mult*p + order_add;
+  if(order < 0) order = 0;
+  if(order > quad->get_max_order() || quad->get_num_points(order) > MAX_PTS_NUM) 
+    error("quadrature order too high in process_vol_forms().");
+  return order;
+}
+
+// add the quadrature (quad, order) to the list of distinct quadratures
+static void add_quad_group(Quad1D **quads, int *orders, int *n_groups, 
+                           Quad1D *quad, int order)
+{
+  for(int i=0; i < *n_groups; i++) 
+    if(quads[i] == quad && orders[i] == order) return;
+  if(*n_groups >= MAX_QUAD_GROUPS) 
+    error("too many different quadratures in process_vol_forms().");
+  quads[*n_groups] = quad;
+  orders[(*n_groups)++] = order;
+}
+
 // process volumetric weak forms
 void DiscreteProblem::process_vol_forms(Matrix *mat, double *res, 
-					double *y_prev, int matrix_flag) {
+					double *y_prev, int matrix_flag,
+                                        ProblemInstance *inst, int first, int last) {
+  void *user_data = (inst != NULL) ? inst->user_data : NULL;
+  double *bc_left = (inst != NULL) ? inst->bc_left_dir_values : NULL;
+  double *bc_right = (inst != NULL) ? inst->bc_right_dir_values : NULL;
   int n_eq = this->mesh->get_n_eq();
   Element *elems = this->mesh->get_elems();
   int n_elem = this->mesh->get_n_elems();
-  for(int m=0; m < n_elem; m++) {
-    //printf("Processing elem %d\n", m);
-    // variables to store quadrature data
-    // FIXME: now maximum number of Gauss points is [MAX_EQN_NUM][MAX_PTS_NUM]0
-    int    pts_num = 0;       // num of quad points
-    double phys_pts[MAX_PTS_NUM];                  // quad points
-    double phys_weights[MAX_PTS_NUM];              // quad weights
-    double phys_u[MAX_PTS_NUM];                    // basis function 
-    double phys_dudx[MAX_PTS_NUM];                 // basis function x-derivative
-    double phys_v[MAX_PTS_NUM];                    // test function
-    double phys_dvdx[MAX_PTS_NUM];                 // test function x-derivative
-    // FIXME: now maximum limit of equations is [MAX_EQN_NUM][MAX_PTS_NUM], 
-    // and number of Gauss points is limited to [MAX_EQN_NUM][MAX_PTS_NUM]0
-    if(n_eq > MAX_EQN_NUM) error("number of equations too high in process_vol_forms().");
-    double phys_u_prev[MAX_EQN_NUM][MAX_PTS_NUM];     // previous solution, all components
-    double phys_du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM];  // previous solution x-derivative, all components
-    // decide quadrature order and set up 
-    // quadrature weights and points in element m
-    // FIXME: for some equations this may not be enough!
-    int order = 2*elems[m].p;
-
-    // prepare quadrature points and weights in physical element m
-    create_element_quadrature(elems[m].v1->x, elems[m].v2->x,  
-	               order, phys_pts, phys_weights, &pts_num); 
-
-    // prepare quadrature points in reference interval (-1, 1)
-    double ref_pts_array[MAX_PTS_NUM];
-    double2 *ref_tab = g_quad_1d_std.get_points(order);
-    for (int j=0; j<pts_num; j++) ref_pts_array[j] = ref_tab[j][0];
-
-    // evaluate previous solution and its derivative 
-    // at all quadrature points in the element, 
-    // for every solution component
-    double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
-    this->mesh->calculate_elem_coeffs(m, y_prev, coeffs); 
-    this->mesh->element_solution(elems + m, coeffs, pts_num, 
-                     ref_pts_array, phys_u_prev, phys_du_prevdx); 
-
-    // DEBUG - SETTING THE PREVIOUS SOLUTION 
-    // TO BE THE EXACT SOLUTION  
-    /*
-    for (int i=0 ; i<pts_num; i++) {
-      phys_u_prev[0][i] = exp(phys_pts[i]);
-      phys_du_prevdx[0][i] = exp(phys_pts[i]);
-      phys_u_prev[1][i] = exp(-phys_pts[i]);
-      phys_du_prevdx[1][i] = -exp(-phys_pts[i]);
+  if(last == -1) last = n_elem;
+
+  // contributions of FORM_CONST matrix forms are either replayed from
+  // the cache or recorded into it during this assembly (the residual
+  // does not touch the cache, so it can be assembled concurrently)
+  bool matrix_needed = (matrix_flag == 0 || matrix_flag == 1);
+  if(matrix_needed && (first != 0 || last != n_elem)) 
+    error("element ranges are for residual assembly only in process_vol_forms().");
+  if(matrix_needed && this->const_cache_revision != this->mesh->get_revision()) {
+    this->invalidate_cache();
+    this->const_cache_revision = this->mesh->get_revision();
+  }
+  bool use_cache = matrix_needed && this->const_cache_valid;
+  bool fill_cache = matrix_needed && !this->const_cache_valid;
+  if(use_cache) {
+    for (int k = 0; k < this->const_cache.size(); k++) {
+      CachedEntry *ce = &this->const_cache[k];
+      mat->add(ce->m, ce->n, ce->val);
     }
-    */    
+  }
 
-    // volumetric bilinear forms
-    if(matrix_flag == 0 || matrix_flag == 1) 
-    {
-      for (int ww = 0; ww < this->matrix_forms_vol.size(); ww++)
-      {
-	MatrixFormVol *mfv = &this->matrix_forms_vol[ww];
-	int c_i = mfv->i;  
-	int c_j = mfv->j;  
-
-	// loop over test functions (rows)
-	for(int i=0; i<elems[m].p + 1; i++) {
-	  // if i-th test function is active
-	  int pos_i = elems[m].dof[c_i][i]; // row in matrix
-	  if(pos_i != -1) {
-	    // transform i-th test function to element 'm'
-	    this->mesh->element_shapefn(elems[m].v1->x, elems[m].v2->x,  
-			    i, order, phys_v, phys_dvdx); 
-	    // if we are constructing the matrix
-	    if(matrix_flag == 0 || matrix_flag == 1) {
-	      // loop over basis functions (columns)
-	      for(int j=0; j < elems[m].p + 1; j++) {
-		int pos_j = elems[m].dof[c_j][j]; // matrix column
-		// if j-th basis function is active
-		if(pos_j != -1) {
-		  // transform j-th basis function to element 'm'
-		  this->mesh->element_shapefn(elems[m].v1->x, elems[m].v2->x,  
-				  j, order, phys_u, phys_dudx); 
-		  // evaluate the bilinear form
-		  double val_ji = mfv->fn(pts_num, phys_pts,
-			    phys_weights, phys_u, phys_dudx, phys_v, phys_dvdx,
-			    phys_u_prev, phys_du_prevdx, NULL); 
-		  //truncating
-		  if (fabs(val_ji) < 1e-12) val_ji = 0.0; 
-		  // add the result to the matrix
-		  if (val_ji != 0) mat->add(pos_j, pos_i, val_ji);
-		  if (DEBUG) {
-		    printf("Elem %d: add to matrix pos %d, %d value %g (comp %d, %d)\n", 
-		    m, pos_i, pos_j, val_ji, c_i, c_j);
-		}
-	      }
-	    }
-	  }
-	}
-      }
-      }}
+  // nothing to integrate (built-in operators are processed separately)
+  int n_matrix_forms = 0;
+  if(matrix_needed) {
+    for (int ww = 0; ww < this->matrix_forms_vol.size(); ww++)
+      if(!(use_cache && (this->matrix_forms_vol[ww].flags & FORM_CONST))) 
+        n_matrix_forms++;
+  }
+  int n_vector_forms = (matrix_flag == 0 || matrix_flag == 2) ? 
+    this->vector_forms_vol.size() : 0;
+  if(n_matrix_forms == 0 && n_vector_forms == 0) {
+    if(fill_cache) this->const_cache_valid = true;
+    return;
+  }
+  if(n_eq > MAX_EQN_NUM) error("number of equations too high in process_vol_forms().");
+  for(int m=first; m < last; m++) {
+    //printf("Processing elem %d\n", m);
+    int p = elems[m].p;
+    if(p > MAX_LOBATTO_ORDER) error("element degree too high in process_vol_forms().");
+    double a = elems[m].v1->x;
+    double b = elems[m].v2->x;
 
-    // volumetric part of residual
+    // coefficients of the previous solution in element m
+    double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+    this->mesh->calculate_elem_coeffs(m, y_prev, coeffs, bc_left, bc_right); 
+
+    // every form has its own quadrature and order; collect the distinct
+    // quadratures needed in element m, so that the quadrature points, the
+    // shape functions and the previous solution are evaluated once for each
+    Quad1D *quads[MAX_QUAD_GROUPS];
+    int orders[MAX_QUAD_GROUPS];
+    int n_groups = 0;
+    if(matrix_flag == 0 || matrix_flag == 1) {
+      for (int ww = 0; ww < this->matrix_forms_vol.size(); ww++) {
+        MatrixFormVol *mfv = &this->matrix_forms_vol[ww];
+        if(use_cache && (mfv->flags & FORM_CONST)) continue;
+        Quad1D *quad = form_quad(mfv->flags);
+        add_quad_group(quads, orders, &n_groups, quad, 
+                       quad_order(mfv->order_mult, mfv->order_add, p, quad));
+      }
+    }
     if(matrix_flag == 0 || matrix_flag == 2) {
-      for (int ww = 0; ww < this->vector_forms_vol.size(); ww++)
-      {
+      for (int ww = 0; ww < this->vector_forms_vol.size(); ww++) {
         VectorFormVol *vfv = &this->vector_forms_vol[ww];
-        int c_i = vfv->i;  
-
-        // loop over test functions (rows)
-        for(int i=0; i<elems[m].p + 1; i++) {
-	  // if i-th test function is active
-	  int pos_i = elems[m].dof[c_i][i]; // row in residual vector
-	  if(pos_i != -1) {
-	    // transform i-th test function to element 'm'
-	    this->mesh->element_shapefn(elems[m].v1->x, elems[m].v2->x,  
-			  i, order, phys_v, phys_dvdx); 
-
-	    // contribute to residual vector
-	    if(matrix_flag == 0 || matrix_flag == 2) {
-	      double val_i = vfv->fn(pts_num, phys_pts, phys_weights, 
-				   phys_u_prev, phys_du_prevdx, phys_v,
-				   phys_dvdx, NULL);
-	      // truncating
-	      if(fabs(val_i) < 1e-12) val_i = 0.0; 
-	      // add the contribution to the residual vector
- 	      if (val_i != 0) res[pos_i] += val_i;
-	      if (DEBUG) {
-		if (val_i != 0) {
-	          printf("Elem %d: add to residual pos %d value %g (comp %d)\n", 
-                  m, pos_i, val_i, c_i);
+        Quad1D *quad = form_quad(vfv->flags);
+        add_quad_group(quads, orders, &n_groups, quad, 
+                       quad_order(vfv->order_mult, vfv->order_add, p, quad));
+      }
+    }
+
+    for(int g=0; g < n_groups; g++) {
+      Quad1D *quad = quads[g];
+      int order = orders[g];
+      // variables to store quadrature data
+      int    pts_num = 0;       // num of quad points
+      double phys_pts[MAX_PTS_NUM];                  // quad points
+      double phys_weights[MAX_PTS_NUM];              // quad weights
+      double phys_shape[MAX_LOBATTO_NUM][MAX_PTS_NUM];  // shape functions
+      double phys_dshape[MAX_LOBATTO_NUM][MAX_PTS_NUM]; // shape functions x-derivatives
+      // FIXME: the form callbacks take the previous solution as
+      // [MAX_EQN_NUM][MAX_PTS_NUM] arrays
+      double phys_u_prev[MAX_EQN_NUM][MAX_PTS_NUM];     // previous solution, all components
+      double phys_du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM];  // previous solution x-derivative, all components
+
+      // prepare quadrature points and weights in physical element m
+      create_element_quadrature(a, b, order, phys_pts, phys_weights, &pts_num, quad); 
+
+      // quadrature points in reference interval (-1, 1)
+      double *ref_pts_array = quad->get_points(order);
+
+      // evaluate previous solution and its derivative 
+      // at all quadrature points in the element, 
+      // for every solution component
+      this->mesh->element_solution(elems + m, coeffs, pts_num, 
+                       ref_pts_array, phys_u_prev, phys_du_prevdx); 
+
+      // transform all shape functions to element 'm'
+      for(int k=0; k <= p; k++) 
+        this->mesh->element_shapefn(a, b, k, order, phys_shape[k], phys_dshape[k], quad); 
+
+      // volumetric bilinear forms
+      if(matrix_flag == 0 || matrix_flag == 1) {
+        for (int ww = 0; ww < this->matrix_forms_vol.size(); ww++)
+        {
+          MatrixFormVol *mfv = &this->matrix_forms_vol[ww];
+          int c_i = mfv->i;  
+          int c_j = mfv->j;  
+          bool is_const = (mfv->flags & FORM_CONST) != 0;
+          // already added from the cache
+          if(use_cache && is_const) continue;
+          // integrated with another quadrature
+          if(form_quad(mfv->flags) != quad || 
+             quad_order(mfv->order_mult, mfv->order_add, p, quad) != order) continue;
+
+          // loop over test functions (rows)
+          for(int i=0; i<p + 1; i++) {
+            // if i-th test function is active
+            int pos_i = elems[m].dof[c_i][i]; // row in matrix
+            if(pos_i == -1) continue;
+            // loop over basis functions (columns)
+            for(int j=0; j < p + 1; j++) {
+              int pos_j = elems[m].dof[c_j][j]; // matrix column
+              // if j-th basis function is active
+              if(pos_j == -1) continue;
+              // evaluate the bilinear form
+              double val_ji = mfv->fn(pts_num, phys_pts, phys_weights, 
+                        phys_shape[j], phys_dshape[j], phys_shape[i], phys_dshape[i],
+                        phys_u_prev, phys_du_prevdx, user_data); 
+              //truncating
+              if (fabs(val_ji) < 1e-12) val_ji = 0.0; 
+              // add the result to the matrix
+              if (val_ji != 0) {
+                mat->add(pos_j, pos_i, val_ji);
+                if (fill_cache && is_const) {
+                  CachedEntry ce = {pos_j, pos_i, val_ji};
+                  this->const_cache.push_back(ce);
                 }
               }
+              if (DEBUG) {
+                printf("Elem %d: add to matrix pos %d, %d value %g (comp %d, %d)\n", 
+                m, pos_i, pos_j, val_ji, c_i, c_j);
+              }
             }
-	  }
-	}
+          }
+        }
       }
-    } 
+
+      // volumetric part of residual
+      if(matrix_flag == 0 || matrix_flag == 2) {
+        for (int ww = 0; ww < this->vector_forms_vol.size(); ww++)
+        {
+          VectorFormVol *vfv = &this->vector_forms_vol[ww];
+          int c_i = vfv->i;  
+          // integrated with another quadrature
+          if(form_quad(vfv->flags) != quad || 
+             quad_order(vfv->order_mult, vfv->order_add, p, quad) != order) continue;
+
+          // loop over test functions (rows)
+          for(int i=0; i<p + 1; i++) {
+            // if i-th test function is active
+            int pos_i = elems[m].dof[c_i][i]; // row in residual vector
+            if(pos_i == -1) continue;
+            // contribute to residual vector
+            double val_i = vfv->fn(pts_num, phys_pts, phys_weights, 
+                                 phys_u_prev, phys_du_prevdx, phys_shape[i],
+                                 phys_dshape[i], user_data);
+            // truncating
+            if(fabs(val_i) < 1e-12) val_i = 0.0; 
+            // add the contribution to the residual vector
+            if (val_i != 0) res[pos_i] += val_i;
+            if (DEBUG) {
+              if (val_i != 0) {
+                printf("Elem %d: add to residual pos %d value %g (comp %d)\n", 
+                m, pos_i, val_i, c_i);
+              }
+            }
+          }
+        }
+      }
+    }
   }
+  if(fill_cache) this->const_cache_valid = true;
 }
 
 // process boundary weak forms
 void DiscreteProblem::process_surf_forms(Matrix *mat, double *res, 
 					 double *y_prev, int matrix_flag, 
-                                         int bdy_index) {
+                                         int bdy_index, ProblemInstance *inst) {
+  void *user_data = (inst != NULL) ? inst->user_data : NULL;
+  double *bc_left = (inst != NULL) ? inst->bc_left_dir_values : NULL;
+  double *bc_right = (inst != NULL) ? inst->bc_right_dir_values : NULL;
   Element *elems = this->mesh->get_elems();
   // evaluate previous solution and its derivative at the end point
   // FIXME: maximum number of equations limited by [MAX_EQN_NUM][MAX_PTS_NUM]
@@ -191,7 +314,7 @@ void DiscreteProblem::process_surf_forms(Matrix *mat, double *res,
 
   // calculate coefficients of shape functions on element m
   double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
-  this->mesh->calculate_elem_coeffs(m, y_prev, coeffs); 
+  this->mesh->calculate_elem_coeffs(m, y_prev, coeffs, bc_left, bc_right); 
   double x_ref; 
   if(bdy_index == BOUNDARY_LEFT) x_ref = -1; // left end of reference element
   else x_ref = 1;                            // right end of reference element
@@ -232,7 +355,7 @@ void DiscreteProblem::process_surf_forms(Matrix *mat, double *res,
               double val_ji_surf = mfs->fn(elems[m].v1->x,
                                phys_u, phys_dudx, phys_v, 
                                phys_dvdx, phys_u_prev, phys_du_prevdx, 
-                               NULL); 
+                               user_data); 
   	      // truncating
 	      if(fabs(val_ji_surf) < 1e-12) val_ji_surf = 0.0; 
               // add the result to the matrix
@@ -264,7 +387,7 @@ void DiscreteProblem::process_surf_forms(Matrix *mat, double *res,
           // evaluate the surface bilinear form
           double val_i_surf = vfs->fn(elems[m].v1->x,
                           phys_u_prev, phys_du_prevdx, phys_v, phys_dvdx, 
-                          NULL); 
+                          user_data); 
           // truncating
           if(fabs(val_i_surf) < 1e-12) val_i_surf = 0.0; 
           // add the result to the matrix
@@ -326,6 +449,59 @@ void DiscreteProblem::process_surf_forms(Matrix *mat, double *res,
 
 }
 
+// process built-in operators: element matrices are the reference
+// matrices scaled by a factor depending on the element length only
+void DiscreteProblem::process_operators(Matrix *mat, double *res, 
+					double *y_prev, int matrix_flag,
+                                        ProblemInstance *inst, int first, int last) {
+  if(this->operator_forms.size() == 0) return;
+  double *bc_left = (inst != NULL) ? inst->bc_left_dir_values : NULL;
+  double *bc_right = (inst != NULL) ? inst->bc_right_dir_values : NULL;
+  Element *elems = this->mesh->get_elems();
+  if(last == -1) last = this->mesh->get_n_elems();
+  for(int m=first; m < last; m++) {
+    int p = elems[m].p;
+    if(p > MAX_LOBATTO_ORDER) error("element degree too high in process_operators().");
+    double jac = (elems[m].v2->x - elems[m].v1->x)/2.;
+    // coefficients of the previous solution (including Dirichlet lift)
+    double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+    this->mesh->calculate_elem_coeffs(m, y_prev, coeffs, bc_left, bc_right); 
+
+    for (int ww = 0; ww < this->operator_forms.size(); ww++)
+    {
+      OperatorForm *opf = &this->operator_forms[ww];
+      int c_i = opf->i;  
+      int c_j = opf->j;  
+      // there is no diagonal lumping of the bubbles (see RefMatrices)
+      if(opf->op == OP_MASS_LUMPED && p > 1) 
+        error("OP_MASS_LUMPED needs elements of degree 1.");
+      double (*ref)[MAX_LOBATTO_NUM] = g_ref_matrices.get(opf->op);
+      double c = opf->elem_coeffs != NULL ? opf->elem_coeffs[m] : opf->coeff;
+      double scale = c*g_ref_matrices.get_scale(opf->op, jac);
+
+      // loop over test functions (rows)
+      for(int i=0; i<p + 1; i++) {
+        int pos_i = elems[m].dof[c_i][i]; // row in matrix
+        if(pos_i == -1) continue;
+        double val_i = 0;
+        // loop over basis functions (columns)
+        for(int j=0; j<p + 1; j++) {
+          // many entries vanish (e.g. the bubble stiffness is diagonal)
+          if(ref[i][j] == 0) continue;
+          double val_ji = scale*ref[i][j];
+          val_i += val_ji*coeffs[c_j][j];
+          int pos_j = elems[m].dof[c_j][j]; // matrix column
+          if((matrix_flag == 0 || matrix_flag == 1) && pos_j != -1) 
+            mat->add(pos_j, pos_i, val_ji);
+        }
+        // the operator is linear, so its residual is the element
+        // matrix times the previous solution
+        if(matrix_flag == 0 || matrix_flag == 2) res[pos_i] += val_i;
+      }
+    }
+  }
+}
+
 // construct Jacobi matrix or residual vector
 // matrix_flag == 0... assembling Jacobi matrix and residual vector together
 // matrix_flag == 1... assembling Jacobi matrix only
@@ -333,7 +509,7 @@ void DiscreteProblem::process_surf_forms(Matrix *mat, double *res,
 // NOTE: Simultaneous assembling of the Jacobi matrix and residual
 // vector is more efficient than if they are assembled separately
 void DiscreteProblem::assemble(Matrix *mat, double *res, 
-              double *y_prev, int matrix_flag) {
+              double *y_prev, int matrix_flag, ProblemInstance *inst) {
   // number of equations in the system
   int n_eq = this->mesh->get_n_eq();
 
@@ -345,13 +521,16 @@ void DiscreteProblem::assemble(Matrix *mat, double *res,
     for(int i=0; i<n_dof; i++) res[i] = 0;
 
   // process volumetric weak forms via an element loop
-  process_vol_forms(mat, res, y_prev, matrix_flag);
+  process_vol_forms(mat, res, y_prev, matrix_flag, inst);
+
+  // process built-in operators via an element loop
+  process_operators(mat, res, y_prev, matrix_flag, inst);
 
   // process surface weak forms for the left boundary
-  process_surf_forms(mat, res, y_prev, matrix_flag, BOUNDARY_LEFT);
+  process_surf_forms(mat, res, y_prev, matrix_flag, BOUNDARY_LEFT, inst);
 
   // process surface weak forms for the right boundary
-  process_surf_forms(mat, res, y_prev, matrix_flag, BOUNDARY_RIGHT);
+  process_surf_forms(mat, res, y_prev, matrix_flag, BOUNDARY_RIGHT, inst);
 
   // DEBUG: print Jacobi matrix
   if(DEBUG && (matrix_flag == 0 || matrix_flag == 1)) {
@@ -374,24 +553,229 @@ void DiscreteProblem::assemble(Matrix *mat, double *res,
 } 
 
 // construct both the Jacobi matrix and the residual vector
-void DiscreteProblem::assemble_matrix_and_vector(Matrix *mat, double *res, double *y_prev) {
-  assemble(mat, res, y_prev, 0);
+void DiscreteProblem::assemble_matrix_and_vector(Matrix *mat, double *res, double *y_prev,
+                                                 ProblemInstance *inst) {
+  assemble(mat, res, y_prev, 0, inst);
 } 
 
 // construct Jacobi matrix only
-void DiscreteProblem::assemble_matrix(Matrix *mat, double *y_prev) {
+void DiscreteProblem::assemble_matrix(Matrix *mat, double *y_prev, ProblemInstance *inst) {
   double *void_res = NULL;
-  assemble(mat, void_res, y_prev, 1);
+  assemble(mat, void_res, y_prev, 1, inst);
 } 
 
 // construct residual vector only
-void DiscreteProblem::assemble_vector(double *res, double *y_prev) {
+void DiscreteProblem::assemble_vector(double *res, double *y_prev, ProblemInstance *inst) {
   Matrix *void_mat = NULL;
-  assemble(void_mat, res, y_prev, 2);
+  assemble(void_mat, res, y_prev, 2, inst);
 } 
 
+struct DiscreteProblem::VectorWorker {
+  DiscreteProblem *self;
+  double *res, *y_prev;
+  ProblemInstance *inst;
+  int first, last;
+  std::string msg;          // error of this thread, empty if none
+};
 
+void *DiscreteProblem::vector_worker(void *data)
+{
+  VectorWorker *w = (VectorWorker *) data;
+  try {
+    w->self->process_vol_forms(NULL, w->res, w->y_prev, 2, w->inst, w->first, w->last);
+    w->self->process_operators(NULL, w->res, w->y_prev, 2, w->inst, w->first, w->last);
+  }
+  catch (std::runtime_error &e) {
+    w->msg = e.what();
+  }
+  return NULL;
+}
 
+void DiscreteProblem::assemble_vector_threaded(double *res, double *y_prev, int n_threads,
+                                               ProblemInstance *inst) {
+  int n_dof = this->mesh->get_n_dof();
+  int n_elem = this->mesh->get_n_elems();
+  if(n_threads > n_elem) n_threads = n_elem;
+  if(n_threads <= 1) {
+    this->assemble_vector(res, y_prev, inst);
+    return;
+  }
 
+  // thread 0 sums into 'res', the others into their own vectors
+  std::vector<double> bufs((long) (n_threads - 1)*n_dof, 0.);
+  std::vector<VectorWorker> workers(n_threads);
+  std::vector<pthread_t> threads(n_threads);
+  for(int i=0; i<n_dof; i++) res[i] = 0;
+  for(int t=0; t < n_threads; t++) {
+    workers[t].self = this;
+    workers[t].res = (t == 0) ? res : &bufs[(long) (t - 1)*n_dof];
+    workers[t].y_prev = y_prev;
+    workers[t].inst = inst;
+    workers[t].first = (long) n_elem*t/n_threads;
+    workers[t].last = (long) n_elem*(t + 1)/n_threads;
+  }
+  // the calling thread does the parts of the threads that cannot be
+  // created, and it waits for the others before reporting any error
+  int n_started = 0;
+  while (n_started < n_threads && 
+         pthread_create(&threads[n_started], NULL, vector_worker, &workers[n_started]) == 0)
+    n_started++;
+  for(int t=n_started; t < n_threads; t++) vector_worker(&workers[t]);
+  for(int t=0; t < n_started; t++) pthread_join(threads[t], NULL);
+  for(int t=0; t < n_threads; t++) 
+    if(!workers[t].msg.empty()) error(workers[t].msg.c_str());
+
+  for(int t=1; t < n_threads; t++) {
+    double *buf = &bufs[(long) (t - 1)*n_dof];
+    for(int i=0; i<n_dof; i++) res[i] += buf[i];
+  }
+  process_surf_forms(NULL, res, y_prev, 2, BOUNDARY_LEFT, inst);
+  process_surf_forms(NULL, res, y_prev, 2, BOUNDARY_RIGHT, inst);
+}
 
+// Marching solver for first-order initial value problems. In element m,
+// the unknowns are the right vertex and bubble coefficients of all
+// solution components, the left vertex value is known from element m-1
+// (or from the Dirichlet condition). The equations are the weak forms
+// tested with the Legendre polynomials P_0, ..., P_{p-1}. This is the
+// continuous Petrov-Galerkin method; its test functions are supported
+// in one element, so the elements are decoupled.
+int DiscreteProblem::solve_marching(double *y, double tol, int max_newton_iter)
+{
+  int n_eq = this->mesh->get_n_eq();
+  Element *elems = this->mesh->get_elems();
+  int n_elem = this->mesh->get_n_elems();
+  int n_dof = this->mesh->get_n_dof();
+  if(this->matrix_forms_surf.size() > 0 || this->vector_forms_surf.size() > 0 ||
+     this->operator_forms.size() > 0)
+    error("solve_marching() supports volumetric weak forms only.");
+  for(int c=0; c < n_eq; c++) {
+    if(elems[0].dof[c][0] != -1) 
+      error("solve_marching() needs a left Dirichlet condition for all components.");
+    if(elems[n_elem-1].dof[c][1] == -1) 
+      error("solve_marching() does not allow a right Dirichlet condition.");
+  }
+  // all forms are integrated with the same points
+  Quad1D *quad = NULL;
+  for (int ww = 0; ww < this->matrix_forms_vol.size(); ww++) {
+    Quad1D *q = form_quad(this->matrix_forms_vol[ww].flags);
+    if(quad != NULL && q != quad) 
+      error("solve_marching() needs the same quadrature for all forms.");
+    quad = q;
+  }
+  for (int ww = 0; ww < this->vector_forms_vol.size(); ww++) {
+    Quad1D *q = form_quad(this->vector_forms_vol[ww].flags);
+    if(quad != NULL && q != quad) 
+      error("solve_marching() needs the same quadrature for all forms.");
+    quad = q;
+  }
+  if(quad == NULL) quad = &g_quad_1d_std;
+  for(int i=0; i < n_dof; i++) y[i] = 0;
+
+  // local Newton system, at most n_eq*MAX_LOBATTO_ORDER unknowns
+  // (std::vector, so that nothing leaks when error() throws)
+  int max_size = n_eq*MAX_LOBATTO_ORDER;
+  std::vector<double> jac_data(max_size*max_size);
+  std::vector<double*> jac_rows(max_size);
+  for(int i=0; i < max_size; i++) jac_rows[i] = &jac_data[i*max_size];
+  double **jac_mat = &jac_rows[0];
+  std::vector<double> loc_res(max_size);
+  std::vector<int> indx(max_size);
+  int total_iter = 0;
+
+  for(int m=0; m < n_elem; m++) {
+    int p = elems[m].p;
+    if(p > MAX_LOBATTO_ORDER) error("element degree too high in solve_marching().");
+    double a = elems[m].v1->x;
+    double b = elems[m].v2->x;
+    int size = n_eq*p;
+
+    // one quadrature for all forms, of the highest order required
+    int order = 0;
+    for (int ww = 0; ww < this->matrix_forms_vol.size(); ww++) {
+      MatrixFormVol *mfv = &this->matrix_forms_vol[ww];
+      int o = quad_order(mfv->order_mult, mfv->order_add, p, quad);
+      if(o > order) order = o;
+    }
+    for (int ww = 0; ww < this->vector_forms_vol.size(); ww++) {
+      VectorFormVol *vfv = &this->vector_forms_vol[ww];
+      int o = quad_order(vfv->order_mult, vfv->order_add, p, quad);
+      if(o > order) order = o;
+    }
+    int    pts_num = 0;
+    double phys_pts[MAX_PTS_NUM];
+    double phys_weights[MAX_PTS_NUM];
+    double phys_shape[MAX_LOBATTO_NUM][MAX_PTS_NUM];
+    double phys_dshape[MAX_LOBATTO_NUM][MAX_PTS_NUM];
+    double phys_test[MAX_LOBATTO_NUM][MAX_PTS_NUM];   // Legendre polynomials
+    double phys_dtest[MAX_LOBATTO_NUM][MAX_PTS_NUM];
+    double phys_u_prev[MAX_EQN_NUM][MAX_PTS_NUM];
+    double phys_du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM];
+    create_element_quadrature(a, b, order, phys_pts, phys_weights, &pts_num, quad); 
+    double *ref_pts_array = quad->get_points(order);
+    for(int k=0; k <= p; k++) 
+      this->mesh->element_shapefn(a, b, k, order, phys_shape[k], phys_dshape[k], quad); 
+    for(int k=0; k < p; k++) {
+      for(int i=0; i < pts_num; i++) {
+        phys_test[k][i] = legendre_fn_tab_1d[k](ref_pts_array[i]);
+        phys_dtest[k][i] = legendre_der_tab_1d[k](ref_pts_array[i]) * 2./(b-a);
+      }
+    }
+
+    // initial guess: the solution is constant in the element
+    double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+    this->mesh->calculate_elem_coeffs(m, y, coeffs); 
+    for(int c=0; c < n_eq; c++) {
+      coeffs[c][1] = coeffs[c][0];
+      for(int j=2; j <= p; j++) coeffs[c][j] = 0;
+    }
+
+    // local Newton's loop, the unknown (c, j) has the index c*p + j-1
+    // for j = 1, ..., p (right vertex, bubbles)
+    int it = 0;
+    while (1) {
+      this->mesh->element_solution(elems + m, coeffs, pts_num, 
+                       ref_pts_array, phys_u_prev, phys_du_prevdx); 
+      for(int i=0; i < size; i++) loc_res[i] = 0;
+      for (int ww = 0; ww < this->vector_forms_vol.size(); ww++) {
+        VectorFormVol *vfv = &this->vector_forms_vol[ww];
+        for(int i=0; i < p; i++) 
+          loc_res[vfv->i*p + i] += vfv->fn(pts_num, phys_pts, phys_weights, 
+                                 phys_u_prev, phys_du_prevdx, phys_test[i],
+                                 phys_dtest[i], NULL);
+      }
+      double res_norm = 0;
+      for(int i=0; i < size; i++) res_norm += loc_res[i]*loc_res[i];
+      res_norm = sqrt(res_norm);
+      if(res_norm < tol) break;
+      if(it++ >= max_newton_iter) 
+        error("Newton's method did not converge in solve_marching().");
+
+      for(int i=0; i < size; i++) 
+        for(int j=0; j < size; j++) jac_mat[i][j] = 0;
+      for (int ww = 0; ww < this->matrix_forms_vol.size(); ww++) {
+        MatrixFormVol *mfv = &this->matrix_forms_vol[ww];
+        for(int i=0; i < p; i++) 
+          for(int j=1; j <= p; j++) 
+            jac_mat[mfv->i*p + i][mfv->j*p + j-1] += 
+              mfv->fn(pts_num, phys_pts, phys_weights, 
+                      phys_shape[j], phys_dshape[j], phys_test[i], phys_dtest[i],
+                      phys_u_prev, phys_du_prevdx, NULL); 
+      }
+      for(int i=0; i < size; i++) loc_res[i] *= -1;
+      double d;
+      ludcmp(jac_mat, size, &indx[0], &d);
+      lubksb<double>(jac_mat, size, &indx[0], &loc_res[0]);
+      for(int c=0; c < n_eq; c++)
+        for(int j=1; j <= p; j++) coeffs[c][j] += loc_res[c*p + j-1];
+    }
+    total_iter += it;
 
+    // store the element solution, the right vertex value is passed
+    // on to element m+1
+    for(int c=0; c < n_eq; c++)
+      for(int j=1; j <= p; j++) y[elems[m].dof[c][j]] = coeffs[c][j];
+  }
+
+  return total_iter;
+}
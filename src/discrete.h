@@ -12,6 +12,17 @@
 #include "quad_std.h"
 #include "lobatto.h"
 #include "matrix.h"
+#include "operators.h"
+
+// flags for add_matrix_form()
+#define FORM_NONLINEAR 0  // form depends on the previous solution
+#define FORM_CONST 1      // form does not depend on the previous solution,
+                          // so its contribution is assembled only once
+#define FORM_QUAD_LOBATTO 2 // integrate with Gauss-Lobatto instead of
+                          // Gauss-Legendre quadrature
+
+// maximum number of distinct quadratures used in one element
+const int MAX_QUAD_GROUPS = 10;
 
 typedef double (*matrix_form) (int num, double *x, double *weights,
         double *u, double *dudx, double *v, double *dvdx, double u_prev[MAX_EQN_NUM][MAX_PTS_NUM],
@@ -30,24 +41,89 @@ typedef double (*vector_form_surf) (double x, double *u_prev,
         double *du_prevdx, double v, double dvdx,
         void *user_data);
 
+/// Data of one instance of a problem, for solving many instances that
+/// differ only in parameters or boundary values with one DiscreteProblem
+/// (see BatchSolver in batch.h). The user data is passed to all forms.
+/// The Dirichlet values (arrays of length n_eq) replace the values set in
+/// the Mesh, NULL means the Mesh values are used.
+struct ProblemInstance {
+    void *user_data;
+    double *bc_left_dir_values;
+    double *bc_right_dir_values;
+};
+
+/// Independent DiscreteProblem objects (with their own meshes) can be used
+/// on different threads at the same time; the library keeps no global
+/// mutable state except the lazily generated quadrature rules, which are
+/// protected by a lock. One DiscreteProblem can be assembled concurrently
+/// only after its first assembly, which fills the cache of FORM_CONST
+/// forms (see BatchSolver). Errors are reported by exceptions (error()).
 class DiscreteProblem {
 
 public:
     DiscreteProblem(Mesh *mesh);
-
-    void add_matrix_form(int i, int j, matrix_form fn);
-    void add_vector_form(int i, vector_form fn);
+    Mesh *get_mesh() {
+        return this->mesh;
+    }
+    // switches to another mesh with the same number of equations, keeping
+    // the forms (operators with elementwise coefficients must not be used)
+    void set_mesh(Mesh *mesh);
+
+    // Forms are integrated in an element of degree p with the quadrature
+    // of order order_mult*p + order_add, the default is 2p. A form with
+    // a fixed integrand degree d can be registered with (0, d).
+    void add_matrix_form(int i, int j, matrix_form fn, int flags=FORM_NONLINEAR,
+                         int order_mult=2, int order_add=0);
+    // the flag FORM_CONST has no effect for vector forms
+    void add_vector_form(int i, vector_form fn, int flags=FORM_NONLINEAR,
+                         int order_mult=2, int order_add=0);
     void add_matrix_form_surf(int i, int j, matrix_form_surf fn, int bdy_index);
     void add_vector_form_surf(int i, vector_form_surf fn, int bdy_index);
-    // c is solution component
-    void process_vol_forms(Matrix *mat, double *res, double *y_prev, int matrix_flag);
+    // built-in linear operator 'op' (see operators.h) acting on solution
+    // component j and tested in equation i, with a constant coefficient
+    // or with one coefficient per element. It contributes both to the
+    // Jacobi matrix and to the residual vector, and it is assembled by
+    // scaling the precomputed reference matrices (no quadrature).
+    void add_operator(int i, int j, int op, double coeff);
+    void add_operator(int i, int j, int op, double *elem_coeffs);
+    // c is solution component; the element loops of process_vol_forms()
+    // and process_operators() can be restricted to the elements
+    // first, ..., last - 1 (last == -1: up to the last element) when
+    // only the residual is assembled
+    void process_vol_forms(Matrix *mat, double *res, double *y_prev, int matrix_flag,
+                           ProblemInstance *inst=NULL, int first=0, int last=-1);
     // c is solution component
     void process_surf_forms(Matrix *mat, double *res, double *y_prev, 
-                            int matrix_flag, int bdy_index);
-    void assemble(Matrix *mat, double *res, double *y_prev, int matrix_flag);
-    void assemble_matrix_and_vector(Matrix *mat, double *res, double *y_prev); 
-    void assemble_matrix(Matrix *mat, double *y_prev);
-    void assemble_vector(double *res, double *y_prev);
+                            int matrix_flag, int bdy_index, ProblemInstance *inst=NULL);
+    void process_operators(Matrix *mat, double *res, double *y_prev, int matrix_flag,
+                           ProblemInstance *inst=NULL, int first=0, int last=-1);
+    // The assembling functions can be called concurrently for different
+    // instances 'inst' once the FORM_CONST cache has been filled by a
+    // matrix assembly (FORM_CONST forms must not depend on the user data).
+    void assemble(Matrix *mat, double *res, double *y_prev, int matrix_flag,
+                  ProblemInstance *inst=NULL);
+    void assemble_matrix_and_vector(Matrix *mat, double *res, double *y_prev,
+                                    ProblemInstance *inst=NULL); 
+    void assemble_matrix(Matrix *mat, double *y_prev, ProblemInstance *inst=NULL);
+    void assemble_vector(double *res, double *y_prev, ProblemInstance *inst=NULL);
+    // assemble_vector() with the elements split among n_threads threads;
+    // every thread sums into its own residual vector and these are added
+    // in a fixed order, so the result depends on n_threads only through
+    // rounding. The vector forms must be safe to call concurrently.
+    void assemble_vector_threaded(double *res, double *y_prev, int n_threads,
+                                  ProblemInstance *inst=NULL);
+    // Solves a first-order initial value problem (all components have a
+    // left Dirichlet condition) element by element from left to right,
+    // with Newton's method on each element, instead of assembling the
+    // global system. Only volumetric forms are allowed. The solution
+    // coefficients are returned in y (length n_dof). 'tol' applies to the
+    // L2 norm of the element residual. Returns the total number of
+    // Newton iterations.
+    int solve_marching(double *y, double tol=1e-10, int max_newton_iter=50);
+    // forget the cached contributions of FORM_CONST forms (call
+    // this when the forms' data have changed; changes of the mesh are
+    // detected by Mesh::get_revision())
+    void invalidate_cache();
 
 private:
     int n_eq;
@@ -56,6 +132,8 @@ private:
 	struct MatrixFormVol {
 		int i, j;
 		matrix_form fn;
+		int flags;
+		int order_mult, order_add;
 	};
 	struct MatrixFormSurf {
 		int i, j, bdy_index;
@@ -64,15 +142,36 @@ private:
 	struct VectorFormVol {
 		int i;
 		vector_form fn;
+		int flags;
+		int order_mult, order_add;
 	};
 	struct VectorFormSurf {
 		int i, bdy_index;
 		vector_form_surf fn;
 	};
+	struct OperatorForm {
+		int i, j, op;
+		double coeff;
+		double *elem_coeffs; // NULL if the coefficient is constant
+	};
 	std::vector<MatrixFormVol> matrix_forms_vol;
 	std::vector<MatrixFormSurf> matrix_forms_surf;
 	std::vector<VectorFormVol> vector_forms_vol;
 	std::vector<VectorFormSurf> vector_forms_surf;
+	std::vector<OperatorForm> operator_forms;
+
+	// global contributions of the FORM_CONST matrix forms
+	struct CachedEntry {
+		int m, n;
+		double val;
+	};
+	std::vector<CachedEntry> const_cache;
+	bool const_cache_valid;
+	int const_cache_revision;  // Mesh::get_revision() the cache was built for
+
+	// element range of one thread in assemble_vector_threaded()
+	struct VectorWorker;
+	static void *vector_worker(void *data);
 };
 
 // return coefficients for all shape functions on the element m,
@@ -0,0 +1,401 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <vector>
+#include <string>
+
+#include "eigen.h"
+
+int band_ordering(Mesh *mesh, int *perm)
+{
+  Element *elems = mesh->get_elems();
+  int n_elem = mesh->get_n_elems();
+  int n_eq = mesh->get_n_eq();
+  int n_dof = mesh->get_n_dof();
+  for (int i=0; i < n_dof; i++) perm[i] = -1;
+
+  int count = 0;
+  int bandwidth = 0;
+  for (int m=0; m < n_elem; m++) {
+    Element *e = elems + m;
+    int min_dof = n_dof, max_dof = -1;
+    for (int c=0; c < n_eq; c++) {
+      // left vertex, bubbles, right vertex
+      for (int j=0; j <= e->p; j++) {
+        int k = (j == 0) ? 0 : ((j == e->p) ? 1 : j+1);
+        int dof = e->dof[c][k];
+        if (dof < 0) continue; // Dirichlet
+        if (perm[dof] < 0) perm[dof] = count++;
+        if (perm[dof] < min_dof) min_dof = perm[dof];
+        if (perm[dof] > max_dof) max_dof = perm[dof];
+      }
+    }
+    if (max_dof - min_dof > bandwidth) bandwidth = max_dof - min_dof;
+  }
+  if (count != n_dof) error("DOF not covered by the elements in band_ordering().");
+
+  return bandwidth;
+}
+
+// Ritz values 'theta' of the Lanczos tridiagonal matrix T_m and their
+// error bounds |beta_m s_{m,i}|, s[][] are the eigenvectors of T_m.
+static void ritz_pairs(int m, double *alpha, double *beta, double *theta,
+        double *bound, double **s)
+{
+  double *e = new double[m];
+  for (int i=0; i < m; i++) {
+    theta[i] = alpha[i];
+    e[i] = (i > 0) ? beta[i-1] : 0;
+    for (int j=0; j < m; j++) s[i][j] = (i == j) ? 1 : 0;
+  }
+  tqli(theta, e, m, s);
+  for (int i=0; i < m; i++) bound[i] = fabs(beta[m-1]*s[m-1][i]);
+  delete [] e;
+}
+
+// sorts the indices of the Ritz values by decreasing |theta|
+static void sort_ritz(int m, double *theta, int *idx)
+{
+  for (int i=0; i < m; i++) idx[i] = i;
+  for (int i=1; i < m; i++) {
+    int t = idx[i];
+    int j = i;
+    while (j > 0 && fabs(theta[idx[j-1]]) < fabs(theta[t])) {
+      idx[j] = idx[j-1];
+      j--;
+    }
+    idx[j] = t;
+  }
+}
+
+int solve_eigen_problem(BandMatrix *A, BandMatrix *B, double sigma, int k,
+        double *eigvals, double **eigvecs, double tol, int max_dim)
+{
+  int n = A->get_size();
+  if (B->get_size() != n) error("matrices of different size in solve_eigen_problem().");
+  if (k < 1 || k > n) error("wrong number of eigenvalues in solve_eigen_problem().");
+  if (max_dim <= 0) max_dim = 4*k + 60;
+  if (max_dim > n) max_dim = n;
+  if (max_dim < k) max_dim = k;
+
+  BandLDLT ldlt(A, B, sigma);
+
+  // Lanczos vectors q_j and B q_j
+  double **q = new_matrix<double>(max_dim + 1, n);
+  double **bq = new_matrix<double>(max_dim + 1, n);
+  double *alpha = new double[max_dim];
+  double *beta = new double[max_dim];
+  double *theta = new double[max_dim];
+  double *bound = new double[max_dim];
+  int *idx = new int[max_dim];
+  double **s = new_matrix<double>(max_dim, max_dim);
+  double *w = new double[n];
+
+  // starting vector, multiplied by the operator to remove the components
+  // from the null space of B
+  for (int i=0; i < n; i++) w[i] = 1 + 0.1*sin(i + 1.);
+  B->mult_vector(w, q[0]);
+  ldlt.solve(q[0]);
+  B->mult_vector(q[0], bq[0]);
+  double norm = 0;
+  for (int i=0; i < n; i++) norm += q[0][i]*bq[0][i];
+  norm = sqrt(norm);
+  for (int i=0; i < n; i++) {
+    q[0][i] /= norm;
+    bq[0][i] /= norm;
+  }
+
+  int m = 0;
+  int n_conv = 0;
+  while (m < max_dim) {
+    // w = (A - sigma B)^{-1} B q_m
+    for (int i=0; i < n; i++) w[i] = bq[m][i];
+    ldlt.solve(w);
+    alpha[m] = 0;
+    for (int i=0; i < n; i++) alpha[m] += w[i]*bq[m][i];
+    for (int i=0; i < n; i++) {
+      w[i] -= alpha[m]*q[m][i];
+      if (m > 0) w[i] -= beta[m-1]*q[m-1][i];
+    }
+    // full reorthogonalization (twice is enough)
+    for (int pass=0; pass < 2; pass++) {
+      for (int j=0; j <= m; j++) {
+        double c = 0;
+        for (int i=0; i < n; i++) c += w[i]*bq[j][i];
+        for (int i=0; i < n; i++) w[i] -= c*q[j][i];
+      }
+    }
+    B->mult_vector(w, bq[m+1]);
+    double b2 = 0;
+    for (int i=0; i < n; i++) b2 += w[i]*bq[m+1][i];
+    beta[m] = sqrt(fabs(b2));
+    m++;
+
+    // invariant subspace found
+    bool breakdown = beta[m-1] <= 1e-14*fabs(alpha[m-1]);
+    if (!breakdown) {
+      for (int i=0; i < n; i++) {
+        q[m][i] = w[i]/beta[m-1];
+        bq[m][i] /= beta[m-1];
+      }
+    }
+    else beta[m-1] = 0;
+
+    // check convergence of the wanted Ritz values
+    if ((m >= k && m % 10 == 0) || m == max_dim || breakdown) {
+      ritz_pairs(m, alpha, beta, theta, bound, s);
+      sort_ritz(m, theta, idx);
+      n_conv = 0;
+      for (int i=0; i < k && i < m; i++)
+        if (bound[idx[i]] <= tol*fabs(theta[idx[i]])) n_conv++;
+        else break;
+      if (n_conv == k) break;
+    }
+    if (breakdown) break;
+  }
+
+  // eigenvalues lambda = sigma + 1/theta and Ritz vectors Q s_i
+  int n_found = (k < m) ? k : m;
+  for (int i=0; i < n_found; i++) {
+    int r = idx[i];
+    eigvals[i] = sigma + 1./theta[r];
+    for (int l=0; l < n; l++) {
+      double v = 0;
+      for (int j=0; j < m; j++) v += q[j][l]*s[j][r];
+      eigvecs[i][l] = v;
+    }
+  }
+  // no Ritz pairs for the rest (after a breakdown with m < k)
+  for (int i=n_found; i < k; i++) {
+    eigvals[i] = NAN;
+    for (int l=0; l < n; l++) eigvecs[i][l] = NAN;
+  }
+  // sort ascending
+  for (int i=1; i < n_found; i++) {
+    for (int j=i; j > 0 && eigvals[j-1] > eigvals[j]; j--) {
+      double t = eigvals[j]; eigvals[j] = eigvals[j-1]; eigvals[j-1] = t;
+      double *tv = eigvecs[j];
+      for (int l=0; l < n; l++) {
+        double x = tv[l]; tv[l] = eigvecs[j-1][l]; eigvecs[j-1][l] = x;
+      }
+    }
+  }
+
+  delete [] (char *) q;
+  delete [] (char *) bq;
+  delete [] (char *) s;
+  delete [] alpha;
+  delete [] beta;
+  delete [] theta;
+  delete [] bound;
+  delete [] idx;
+  delete [] w;
+
+  return n_conv;
+}
+
+int count_eigenvalues(BandMatrix *A, BandMatrix *B, double a, double b)
+{
+  BandLDLT ldlt_a(A, B, a);
+  BandLDLT ldlt_b(A, B, b);
+  return ldlt_b.get_num_negative() - ldlt_a.get_num_negative();
+}
+
+// slice [a, b) of the spectrum, n_a and n_b are the numbers of
+// eigenvalues below a and b
+struct EigenSlice {
+  double a, b;
+  int n_a, n_b;
+};
+
+struct EigenSliceResult {
+  double a;
+  int n;
+  double *eigvals;
+  double **eigvecs;
+};
+
+// work queue shared by the threads of solve_eigen_interval()
+struct EigenSliceQueue {
+  BandMatrix *A, *B;
+  int slice_size;
+  double tol;
+  std::vector<EigenSlice> slices;
+  std::vector<EigenSliceResult> results;
+  int n_busy;            // number of slices being processed
+  std::string error_msg; // first error reported by a thread
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+// Solves one slice. Returns false (and bisects it into s1 and s2) if the
+// slice has too many eigenvalues or if the Lanczos method did not find
+// all of them.
+static bool solve_slice(EigenSliceQueue *q, EigenSlice *s, EigenSliceResult *res,
+        EigenSlice *s1, EigenSlice *s2)
+{
+  int n = q->A->get_size();
+  int count = s->n_b - s->n_a;
+  res->a = s->a;
+  res->n = 0;
+  res->eigvals = NULL;
+  res->eigvecs = NULL;
+  if (count == 0) return true;
+
+  double mid = 0.5*(s->a + s->b);
+  bool split = count > q->slice_size;
+  if (!split) {
+    double *eigvals = new double[count];
+    double **eigvecs = new_matrix<double>(count, n);
+    int n_conv = solve_eigen_problem(q->A, q->B, mid, count, eigvals, eigvecs, q->tol);
+    // the 'count' eigenvalues closest to the midpoint are exactly
+    // the ones in the slice, if they have all converged
+    int found = 0;
+    if (n_conv == count)
+      for (int i=0; i < count; i++)
+        if (eigvals[i] >= s->a && eigvals[i] < s->b) found++;
+    if (found == count) {
+      res->n = count;
+      res->eigvals = eigvals;
+      res->eigvecs = eigvecs;
+      return true;
+    }
+    delete [] eigvals;
+    delete [] (char *) eigvecs;
+  }
+
+  if (s->b - s->a <= 1e-12*(fabs(s->a) + fabs(s->b) + 1))
+    error("cannot separate eigenvalues in solve_eigen_interval() (multiple eigenvalue?).");
+  BandLDLT ldlt(q->A, q->B, mid);
+  int n_mid = ldlt.get_num_negative();
+  s1->a = s->a;  s1->b = mid;  s1->n_a = s->n_a;  s1->n_b = n_mid;
+  s2->a = mid;   s2->b = s->b; s2->n_a = n_mid;   s2->n_b = s->n_b;
+  return false;
+}
+
+static void *slice_worker(void *data)
+{
+  EigenSliceQueue *q = (EigenSliceQueue *) data;
+  pthread_mutex_lock(&q->lock);
+  while (true) {
+    while (q->slices.empty() && q->n_busy > 0)
+      pthread_cond_wait(&q->cond, &q->lock);
+    if (q->slices.empty()) break;
+    EigenSlice s = q->slices.back();
+    q->slices.pop_back();
+    q->n_busy++;
+    pthread_mutex_unlock(&q->lock);
+
+    EigenSliceResult res;
+    EigenSlice s1, s2;
+    bool done = false, failed = false;
+    std::string msg;
+    try {
+      done = solve_slice(q, &s, &res, &s1, &s2);
+    }
+    catch (std::runtime_error &e) {
+      failed = true;
+      msg = e.what();
+    }
+
+    pthread_mutex_lock(&q->lock);
+    if (failed) {
+      // the other threads stop after their current slice
+      if (q->error_msg.empty()) q->error_msg = msg;
+      q->slices.clear();
+    }
+    else if (!q->error_msg.empty()) {
+      if (done) {
+        delete [] res.eigvals;
+        delete [] (char *) res.eigvecs;
+      }
+    }
+    else if (done) q->results.push_back(res);
+    else {
+      q->slices.push_back(s1);
+      q->slices.push_back(s2);
+    }
+    q->n_busy--;
+    pthread_cond_broadcast(&q->cond);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return NULL;
+}
+
+int solve_eigen_interval(BandMatrix *A, BandMatrix *B, double a, double b,
+        int max_eigs, double *eigvals, double **eigvecs, int n_threads,
+        int slice_size, double tol)
+{
+  if (a >= b) error("empty interval in solve_eigen_interval().");
+  if (n_threads < 1) n_threads = 1;
+  if (slice_size < 1) slice_size = 1;
+  int n = A->get_size();
+
+  EigenSliceQueue q;
+  q.A = A;
+  q.B = B;
+  q.slice_size = slice_size;
+  q.tol = tol;
+  q.n_busy = 0;
+  EigenSlice s;
+  s.a = a;
+  s.b = b;
+  BandLDLT ldlt_a(A, B, a);
+  BandLDLT ldlt_b(A, B, b);
+  s.n_a = ldlt_a.get_num_negative();
+  s.n_b = ldlt_b.get_num_negative();
+  int total = s.n_b - s.n_a;
+  if (total > max_eigs) error("too many eigenvalues in the interval in solve_eigen_interval().");
+  q.slices.push_back(s);
+  pthread_mutex_init(&q.lock, NULL);
+  pthread_cond_init(&q.cond, NULL);
+
+  // if a thread cannot be created, the calling thread joins the others
+  // in processing the queue (which must outlive all of them)
+  pthread_t *threads = new pthread_t[n_threads];
+  int n_started = 0;
+  while (n_started < n_threads &&
+         pthread_create(&threads[n_started], NULL, slice_worker, &q) == 0) 
+    n_started++;
+  if (n_started < n_threads) slice_worker(&q);
+  for (int i=0; i < n_started; i++) pthread_join(threads[i], NULL);
+  delete [] threads;
+  pthread_mutex_destroy(&q.lock);
+  pthread_cond_destroy(&q.cond);
+  if (!q.error_msg.empty()) {
+    for (int i=0; i < q.results.size(); i++) {
+      delete [] q.results[i].eigvals;
+      delete [] (char *) q.results[i].eigvecs;
+    }
+    error(q.error_msg.c_str());
+  }
+
+  // the slices are disjoint, so sorting them by their left end points
+  // sorts the eigenvalues
+  int n_res = q.results.size();
+  for (int i=1; i < n_res; i++) {
+    EigenSliceResult r = q.results[i];
+    int j = i;
+    while (j > 0 && q.results[j-1].a > r.a) {
+      q.results[j] = q.results[j-1];
+      j--;
+    }
+    q.results[j] = r;
+  }
+  int count = 0;
+  for (int i=0; i < n_res; i++) {
+    EigenSliceResult *r = &q.results[i];
+    for (int j=0; j < r->n; j++) {
+      eigvals[count] = r->eigvals[j];
+      for (int l=0; l < n; l++) eigvecs[count][l] = r->eigvecs[j][l];
+      count++;
+    }
+    delete [] r->eigvals;
+    delete [] (char *) r->eigvecs;
+  }
+  if (count != total) error("eigenvalues lost in solve_eigen_interval().");
+
+  return count;
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_EIGEN_H
+#define __HERMES1D_EIGEN_H
+
+#include <pthread.h>
+
+#include "common.h"
+#include "mesh.h"
+#include "matrix.h"
+
+/// Calculates a permutation of the DOF of the mesh which makes the
+/// matrices of the discrete problem banded: the DOF are numbered element
+/// by element (left vertex, bubbles, right vertex), so all DOF of an
+/// element are close to each other. perm[i] is the new number of the DOF
+/// 'i', the array must have length mesh->get_n_dof(). Returns the
+/// half-bandwidth of the permuted matrices.
+int band_ordering(Mesh *mesh, int *perm);
+
+/// Solves the generalized eigenproblem A x = lambda B x, where A and B
+/// are symmetric and B is positive definite, for the 'k' eigenvalues
+/// closest to the shift 'sigma' (from above if sigma is below the
+/// spectrum). The Lanczos method is applied to the shift-inverted operator
+/// (A - sigma B)^{-1} B in the B-inner product, with full
+/// reorthogonalization. A and B must have the same size and permutation.
+///
+/// On return, eigvals[0..k-1] are the eigenvalues sorted ascending and
+/// eigvecs[i] (an array of length A->get_size()) is the B-normalized
+/// eigenvector of eigvals[i]. 'tol' is the relative residual tolerance
+/// and 'max_dim' the maximum dimension of the Krylov space (0 means
+/// min(n, 4k + 60)). Returns the number of converged eigenpairs. If the
+/// Krylov space becomes invariant with dimension m < k, only m pairs are
+/// computed, the remaining entries of eigvals and eigvecs are set to NaN.
+int solve_eigen_problem(BandMatrix *A, BandMatrix *B, double sigma, int k,
+        double *eigvals, double **eigvecs, double tol=1e-10, int max_dim=0);
+
+/// Number of eigenvalues of A x = lambda B x in the interval [a, b), from
+/// the inertia (Sylvester's law) of the LDL^T factorizations of A - a B
+/// and A - b B.
+int count_eigenvalues(BandMatrix *A, BandMatrix *B, double a, double b);
+
+/// Spectrum slicing: computes all eigenpairs of A x = lambda B x with
+/// eigenvalues in [a, b). The interval is bisected into half-open slices
+/// until each one contains at most 'slice_size' eigenvalues (counted by
+/// inertia), and the slices are solved by solve_eigen_problem() with the
+/// shift in their midpoints on 'n_threads' threads. A slice where the
+/// Lanczos method does not deliver exactly the counted eigenvalues is
+/// bisected again, so the result is complete and has no duplicates.
+///
+/// eigvals and eigvecs (max_eigs arrays of length A->get_size()) return
+/// the eigenpairs sorted ascending. Returns the number of eigenvalues
+/// in [a, b), it is an error if it is larger than max_eigs.
+int solve_eigen_interval(BandMatrix *A, BandMatrix *B, double a, double b,
+        int max_eigs, double *eigvals, double **eigvecs, int n_threads=4,
+        int slice_size=20, double tol=1e-10);
+
+#endif
@@ -0,0 +1,317 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <string.h>
+
+#include "ensemble.h"
+#include "batch.h"
+
+EnsembleMatrix::EnsembleMatrix(int size, int nnz, int *IA, int *JA)
+{
+    this->size = size;
+    this->nnz = nnz;
+    this->IA = new int[size+1];
+    this->JA = new int[nnz > 0 ? nnz : 1];
+    memcpy(this->IA, IA, (size+1)*sizeof(int));
+    memcpy(this->JA, JA, nnz*sizeof(int));
+    void *ptr = NULL;
+    int n_values = (nnz > 0 ? nnz : 1)*ENS_W;
+    if (posix_memalign(&ptr, QUAD_ALIGNMENT, n_values*sizeof(double)) != 0)
+        error("out of memory in EnsembleMatrix.");
+    this->values = (double *) ptr;
+    this->zero();
+}
+
+EnsembleMatrix::~EnsembleMatrix()
+{
+    delete [] this->IA;
+    delete [] this->JA;
+    free(this->values);
+}
+
+void EnsembleMatrix::zero()
+{
+    for (int k=0; k < this->nnz*ENS_W; k++) this->values[k] = 0;
+}
+
+void EnsembleMatrix::add(int m, int n, double *val)
+{
+    // binary search in the sorted column indices of the row m
+    int lo = this->IA[m], hi = this->IA[m+1] - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi)/2;
+        if (this->JA[mid] == n) {
+            double *v = this->values + mid*ENS_W;
+            for (int w=0; w < ENS_W; w++) v[w] += val[w];
+            return;
+        }
+        if (this->JA[mid] < n) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    error("EnsembleMatrix::add(): entry outside of the sparsity pattern.");
+}
+
+void EnsembleMatrix::get_instance(int w, double *A)
+{
+    for (int k=0; k < this->nnz; k++) A[k] = this->values[k*ENS_W + w];
+}
+
+EnsembleProblem::EnsembleProblem(Mesh *mesh)
+{
+    this->mesh = mesh;
+}
+
+void EnsembleProblem::add_matrix_form(int i, int j, matrix_form_ens fn, 
+                                      int order_mult, int order_add)
+{
+    MatrixFormEns form = {i, j, fn, order_mult, order_add};
+    this->matrix_forms.push_back(form);
+}
+
+void EnsembleProblem::add_vector_form(int i, vector_form_ens fn, 
+                                      int order_mult, int order_add)
+{
+    VectorFormEns form = {i, fn, order_mult, order_add};
+    this->vector_forms.push_back(form);
+}
+
+// Gauss quadrature order order_mult*p + order_add in an element of degree p
+static int ens_quad_order(int order_mult, int order_add, int p)
+{
+  int order = order_mult*p + order_add;
+  if(order < 0) order = 0;
+  if(order > g_quad_1d_std.get_max_order() || 
+     g_quad_1d_std.get_num_points(order) > MAX_PTS_NUM) 
+    error("quadrature order too high in EnsembleProblem::assemble().");
+  return order;
+}
+
+// add 'order' to the list of distinct quadrature orders
+static void add_order(int *orders, int *n_groups, int order)
+{
+  for(int g=0; g < *n_groups; g++) if(orders[g] == order) return;
+  if(*n_groups >= MAX_QUAD_GROUPS) 
+    error("too many different quadratures in EnsembleProblem::assemble().");
+  orders[(*n_groups)++] = order;
+}
+
+// truncation of small contributions, as in DiscreteProblem
+static inline bool ens_truncate(double *val)
+{
+  bool nonzero = false;
+  for (int w=0; w < ENS_W; w++) {
+    if (fabs(val[w]) < 1e-12) val[w] = 0;
+    else nonzero = true;
+  }
+  return nonzero;
+}
+
+void EnsembleProblem::assemble(EnsembleMatrix *mat, double *res, double **y_prev,
+                               ProblemInstance *inst, int matrix_flag)
+{
+  int n_eq = this->mesh->get_n_eq();
+  int n_dof = this->mesh->get_n_dof();
+  Element *elems = this->mesh->get_elems();
+  int n_elem = this->mesh->get_n_elems();
+  if(n_eq > MAX_EQN_NUM) error("number of equations too high in EnsembleProblem::assemble().");
+  bool do_matrix = (matrix_flag == 0 || matrix_flag == 1);
+  bool do_vector = (matrix_flag == 0 || matrix_flag == 2);
+  if(do_vector) 
+    for(int i=0; i < n_dof*ENS_W; i++) res[i] = 0;
+
+  void *user_data[ENS_W];
+  for(int w=0; w < ENS_W; w++) user_data[w] = inst[w].user_data;
+
+  double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  double ens_coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM][ENS_W];
+  double phys_pts[MAX_PTS_NUM];
+  double phys_weights[MAX_PTS_NUM];
+  double phys_shape[MAX_LOBATTO_NUM][MAX_PTS_NUM];
+  double phys_dshape[MAX_LOBATTO_NUM][MAX_PTS_NUM];
+  double phys_u_prev[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W];
+  double phys_du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W];
+  double val[ENS_W];
+
+  for(int m=0; m < n_elem; m++) {
+    int p = elems[m].p;
+    if(p > MAX_LOBATTO_ORDER) error("element degree too high in EnsembleProblem::assemble().");
+    double a = elems[m].v1->x;
+    double b = elems[m].v2->x;
+
+    // coefficients of the previous solutions in element m, interleaved
+    for(int w=0; w < ENS_W; w++) {
+      this->mesh->calculate_elem_coeffs(m, y_prev[w], coeffs, 
+              inst[w].bc_left_dir_values, inst[w].bc_right_dir_values);
+      for(int c=0; c < n_eq; c++)
+        for(int k=0; k <= p; k++) ens_coeffs[c][k][w] = coeffs[c][k];
+    }
+
+    // distinct quadrature orders needed in element m
+    int orders[MAX_QUAD_GROUPS];
+    int n_groups = 0;
+    if(do_matrix) 
+      for(int ww=0; ww < this->matrix_forms.size(); ww++) 
+        add_order(orders, &n_groups, ens_quad_order(this->matrix_forms[ww].order_mult, 
+                                   this->matrix_forms[ww].order_add, p));
+    if(do_vector) 
+      for(int ww=0; ww < this->vector_forms.size(); ww++) 
+        add_order(orders, &n_groups, ens_quad_order(this->vector_forms[ww].order_mult, 
+                                   this->vector_forms[ww].order_add, p));
+
+    for(int g=0; g < n_groups; g++) {
+      int order = orders[g];
+      int pts_num = 0;
+      create_element_quadrature(a, b, order, phys_pts, phys_weights, &pts_num);
+      for(int k=0; k <= p; k++) 
+        this->mesh->element_shapefn(a, b, k, order, phys_shape[k], phys_dshape[k]); 
+
+      // previous solutions of all instances at the quadrature points
+      for(int c=0; c < n_eq; c++) {
+        for(int i=0; i < pts_num; i++) {
+          double *u = phys_u_prev[c][i];
+          double *du = phys_du_prevdx[c][i];
+          for(int w=0; w < ENS_W; w++) u[w] = du[w] = 0;
+          for(int k=0; k <= p; k++) {
+            double s = phys_shape[k][i], ds = phys_dshape[k][i];
+            double *ck = ens_coeffs[c][k];
+            for(int w=0; w < ENS_W; w++) {
+              u[w] += ck[w]*s;
+              du[w] += ck[w]*ds;
+            }
+          }
+        }
+      }
+
+      if(do_matrix) {
+        for(int ww=0; ww < this->matrix_forms.size(); ww++) {
+          MatrixFormEns *mf = &this->matrix_forms[ww];
+          if(ens_quad_order(mf->order_mult, mf->order_add, p) != order) continue;
+          for(int i=0; i < p + 1; i++) {
+            int pos_i = elems[m].dof[mf->i][i];
+            if(pos_i == -1) continue;
+            for(int j=0; j < p + 1; j++) {
+              int pos_j = elems[m].dof[mf->j][j];
+              if(pos_j == -1) continue;
+              mf->fn(pts_num, phys_pts, phys_weights, 
+                     phys_shape[j], phys_dshape[j], phys_shape[i], phys_dshape[i],
+                     phys_u_prev, phys_du_prevdx, user_data, val);
+              // stored transposed, as in DiscreteProblem
+              if(ens_truncate(val)) mat->add(pos_j, pos_i, val);
+            }
+          }
+        }
+      }
+
+      if(do_vector) {
+        for(int ww=0; ww < this->vector_forms.size(); ww++) {
+          VectorFormEns *vf = &this->vector_forms[ww];
+          if(ens_quad_order(vf->order_mult, vf->order_add, p) != order) continue;
+          for(int i=0; i < p + 1; i++) {
+            int pos_i = elems[m].dof[vf->i][i];
+            if(pos_i == -1) continue;
+            vf->fn(pts_num, phys_pts, phys_weights, phys_u_prev, phys_du_prevdx, 
+                   phys_shape[i], phys_dshape[i], user_data, val);
+            ens_truncate(val);
+            double *r = res + pos_i*ENS_W;
+            for(int w=0; w < ENS_W; w++) r[w] += val[w];
+          }
+        }
+      }
+    }
+  }
+}
+
+int solve_ensemble(EnsembleProblem *ep, Solver *solver, int n_inst,
+                   ProblemInstance *inst, double **y, int *iters,
+                   double tol, int max_iter)
+{
+  if (solver->is_row_oriented()) 
+    error("row-oriented solvers are not supported by solve_ensemble().");
+  Mesh *mesh = ep->get_mesh();
+  int n = mesh->get_n_dof();
+  int nnz, *IA, *JA;
+  build_element_pattern(mesh, &nnz, &IA, &JA);
+  EnsembleMatrix ens_mat(n, nnz, IA, JA);
+  CSRMatrix mat(n, nnz, IA, JA);
+  delete [] IA;
+  delete [] JA;
+  std::vector<double> res(n*ENS_W), rhs(n), vec(n);
+  // padding lanes of the last group work on a copy of the last instance
+  std::vector<double> y_pad(n*ENS_W);
+
+  // one factorization context per lane, the pattern is analyzed once
+  SolverContexts contexts(solver, ENS_W);
+  void *ctx[ENS_W];
+  bool analyzed = true;
+  for(int w=0; w < ENS_W; w++) {
+    ctx[w] = contexts.get(w);
+    if(!solver->analyze(ctx[w], n, mat.get_IA(), mat.get_JA(), mat.get_A(), false))
+      analyzed = false;
+  }
+
+  int n_failed = 0;
+  for(int k0=0; k0 < n_inst; k0 += ENS_W) {
+    ProblemInstance lane_inst[ENS_W];
+    double *lane_y[ENS_W];
+    // Newton iterations of each lane, -1 while running, -2 if failed
+    int lane_it[ENS_W];
+    for(int w=0; w < ENS_W; w++) {
+      int k = k0 + w;
+      if(k < n_inst) {
+        lane_inst[w] = inst[k];
+        lane_y[w] = y[k];
+        lane_it[w] = analyzed ? -1 : -2;
+      }
+      else {
+        lane_inst[w] = inst[n_inst-1];
+        lane_y[w] = &y_pad[w*n];
+        memcpy(lane_y[w], y[n_inst-1], n*sizeof(double));
+        lane_it[w] = 0;
+      }
+    }
+
+    for(int it=0; ; it++) {
+      bool running = false;
+      for(int w=0; w < ENS_W; w++) if(lane_it[w] == -1) running = true;
+      if(!running) break;
+
+      // all lanes are assembled together, the converged ones are
+      // not updated any more
+      ens_mat.zero();
+      ep->assemble(&ens_mat, &res[0], lane_y, lane_inst, 0);
+      for(int w=0; w < ENS_W; w++) {
+        if(lane_it[w] != -1) continue;
+        double res_norm = 0;
+        for(int i=0; i < n; i++) res_norm += res[i*ENS_W + w]*res[i*ENS_W + w];
+        res_norm = sqrt(res_norm);
+        if(res_norm < tol) {
+          lane_it[w] = it;
+          continue;
+        }
+        if(it >= max_iter) {
+          lane_it[w] = -2;
+          continue;
+        }
+        for(int i=0; i < n; i++) rhs[i] = -res[i*ENS_W + w];
+        ens_mat.get_instance(w, mat.get_A());
+        if(!solver->factorize(ctx[w], n, mat.get_IA(), mat.get_JA(), mat.get_A(), false) ||
+           !solver->solve(ctx[w], n, mat.get_IA(), mat.get_JA(), mat.get_A(), false, 
+                          &rhs[0], &vec[0])) {
+          lane_it[w] = -2;
+          continue;
+        }
+        for(int i=0; i < n; i++) lane_y[w][i] += vec[i];
+      }
+    }
+
+    for(int w=0; w < ENS_W && k0 + w < n_inst; w++) {
+      int iter = (lane_it[w] >= 0) ? lane_it[w] : -1;
+      if(iters != NULL) iters[k0 + w] = iter;
+      if(iter < 0) n_failed++;
+    }
+  }
+
+  return n_failed;
+}
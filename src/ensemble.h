@@ -0,0 +1,132 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_ENSEMBLE_H
+#define __HERMES1D_ENSEMBLE_H
+
+#include <vector>
+
+#include "common.h"
+#include "mesh.h"
+#include "matrix.h"
+#include "solver.h"
+#include "discrete.h"
+
+// number of instances processed together by the ensemble forms (one
+// instance per SIMD lane, 4 doubles fill an AVX register)
+const int ENS_W = 4;
+
+/// Ensemble forms evaluate the same weak form for ENS_W instances at once.
+/// The shape functions u, v are common to all instances, the previous
+/// solutions are interleaved by instance (u_prev[c][i][w] is the value of
+/// component c at the point i in the instance w), user_data[w] is the user
+/// data of the instance w and the results are returned in val[ENS_W].
+/// The loops over the lanes w should be innermost, so that the compiler
+/// vectorizes them.
+typedef void (*matrix_form_ens) (int num, double *x, double *weights,
+        double *u, double *dudx, double *v, double *dvdx, 
+        double u_prev[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W],
+        double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W], 
+        void **user_data, double *val);
+
+typedef void (*vector_form_ens) (int num, double *x, double *weights,
+        double u_prev[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W],
+        double du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM][ENS_W], 
+        double *v, double *dvdx, void **user_data, double *val);
+
+/// ENS_W sparse matrices with a common sparsity pattern (CSR, sorted
+/// column indices). The values are stored interleaved by instance: the
+/// entry k of the instance w is values[k*ENS_W + w].
+class EnsembleMatrix {
+    public:
+        // the pattern arrays are copied
+        EnsembleMatrix(int size, int nnz, int *IA, int *JA);
+        ~EnsembleMatrix();
+
+        void zero();
+        // adds val[w] to the entry (m, n) of every instance w; the entry
+        // must be in the pattern
+        void add(int m, int n, double *val);
+        // copies the values of the instance w to A (length nnz), e.g. to
+        // the values of a CSRMatrix with the same pattern
+        void get_instance(int w, double *A);
+
+        int get_size() {
+            return this->size;
+        }
+        int get_nnz() {
+            return this->nnz;
+        }
+        int *get_IA() {
+            return this->IA;
+        }
+        int *get_JA() {
+            return this->JA;
+        }
+        double *get_values() {
+            return this->values;
+        }
+
+    private:
+        int size;
+        int nnz;
+        int *IA;
+        int *JA;
+        double *values;
+};
+
+/// Discrete problem evaluated for ENS_W instances at once, with ensemble
+/// volumetric forms (built-in operators and surface forms are not
+/// supported). The instances differ in their user data and Dirichlet
+/// values (ProblemInstance), the mesh and the forms are shared.
+class EnsembleProblem {
+public:
+    EnsembleProblem(Mesh *mesh);
+    Mesh *get_mesh() {
+        return this->mesh;
+    }
+
+    // quadrature of order order_mult*p + order_add, as in DiscreteProblem
+    void add_matrix_form(int i, int j, matrix_form_ens fn, 
+                         int order_mult=2, int order_add=0);
+    void add_vector_form(int i, vector_form_ens fn, 
+                         int order_mult=2, int order_add=0);
+
+    // Assembles the Jacobi matrices (into 'mat', whose pattern must
+    // contain build_element_pattern()) and the residual vectors of the
+    // instances inst[w] with the solutions y_prev[w], w = 0..ENS_W-1.
+    // The residuals are interleaved: res[i*ENS_W + w]. The matrix_flag
+    // and the storage of the matrices are as in DiscreteProblem::assemble().
+    void assemble(EnsembleMatrix *mat, double *res, double **y_prev,
+                  ProblemInstance *inst, int matrix_flag);
+
+private:
+    Mesh *mesh;
+
+	struct MatrixFormEns {
+		int i, j;
+		matrix_form_ens fn;
+		int order_mult, order_add;
+	};
+	struct VectorFormEns {
+		int i;
+		vector_form_ens fn;
+		int order_mult, order_add;
+	};
+	std::vector<MatrixFormEns> matrix_forms;
+	std::vector<VectorFormEns> vector_forms;
+};
+
+/// Solves n_inst instances by Newton's method, ENS_W instances per
+/// ensemble assembly; the linear systems are solved one instance at a
+/// time with 'solver'. y[k] (length n_dof) is the initial guess of the
+/// instance k and returns its solution, iters[k] (if not NULL) the number
+/// of Newton iterations or -1. Returns the number of instances that did
+/// not converge.
+int solve_ensemble(EnsembleProblem *ep, Solver *solver, int n_inst,
+                   ProblemInstance *inst, double **y, int *iters=NULL,
+                   double tol=1e-8, int max_iter=50);
+
+#endif
@@ -0,0 +1,256 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <math.h>
+#include <pthread.h>
+#include <string>
+
+#include "functional.h"
+
+Functionals::Functionals(Mesh *mesh)
+{
+  this->mesh = mesh;
+  for (int n=0; n <= MAX_PTS_NUM; n++) this->tables[n] = NULL;
+}
+
+Functionals::~Functionals()
+{
+  for (int n=0; n <= MAX_PTS_NUM; n++) delete this->tables[n];
+}
+
+int Functionals::add_builtin(int type, int comp, projection_fn exact, void *exact_data)
+{
+  if (type < FUNC_INTEGRAL || type > FUNC_H1_ERROR) 
+    error("unknown functional in Functionals::add_builtin().");
+  if (comp < 0 || comp >= this->mesh->get_n_eq()) 
+    error("invalid solution component in Functionals::add_builtin().");
+  Functional f;
+  f.type = type;
+  f.comp = comp;
+  f.exact = -1;
+  f.fn = NULL;
+  f.user_data = NULL;
+  f.order_mult = 2;
+  f.order_add = 0;
+  if (type >= FUNC_L2_ERROR) {
+    if (exact == NULL) error("exact solution missing in Functionals::add_builtin().");
+    // the exact solution is evaluated once per point for all its errors
+    for (int i=0; i < (int) this->exact_fns.size(); i++)
+      if (this->exact_fns[i].fn == exact && this->exact_fns[i].data == exact_data) 
+        f.exact = i;
+    if (f.exact == -1) {
+      ExactFn e;
+      e.fn = exact;
+      e.data = exact_data;
+      f.exact = this->exact_fns.size();
+      this->exact_fns.push_back(e);
+    }
+    f.order_add = 4;
+  }
+  this->funcs.push_back(f);
+  return this->funcs.size() - 1;
+}
+
+int Functionals::add_functional(functional_form fn, void *user_data, 
+                                int order_mult, int order_add)
+{
+  Functional f;
+  f.type = -1;
+  f.comp = 0;
+  f.exact = -1;
+  f.fn = fn;
+  f.user_data = user_data;
+  f.order_mult = order_mult;
+  f.order_add = order_add;
+  this->funcs.push_back(f);
+  return this->funcs.size() - 1;
+}
+
+// quadrature order in an element of degree p
+int Functionals::get_order(int p)
+{
+  int order = 2*p;
+  for (int i=0; i < (int) this->funcs.size(); i++) {
+    int o = this->funcs[i].order_mult*p + this->funcs[i].order_add;
+    if (o > order) order = o;
+  }
+  return order;
+}
+
+void Functionals::evaluate_element(int m, double *y, double *sums)
+{
+  int n_eq = this->mesh->get_n_eq();
+  int n_func = this->funcs.size();
+  Element *e = this->mesh->get_elems() + m;
+  int p = e->p;
+  double a = e->v1->x, b = e->v2->x;
+  double jac = (b - a)/2;
+  ShapeTable *t = this->tables[g_quad_1d_std.get_num_points(this->get_order(p))];
+  int num = t->num;
+
+  double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  this->mesh->calculate_elem_coeffs(m, y, coeffs);
+  double x[MAX_PTS_NUM], w[MAX_PTS_NUM];
+  double u[MAX_EQN_NUM][MAX_PTS_NUM], dudx[MAX_EQN_NUM][MAX_PTS_NUM];
+  for (int i=0; i < num; i++) {
+    x[i] = jac*t->pts[i] + (a + b)/2;
+    w[i] = jac*t->weights[i];
+  }
+  for (int c=0; c < n_eq; c++) {
+    for (int i=0; i < num; i++) u[c][i] = dudx[c][i] = 0;
+    for (int k=0; k <= p; k++) {
+      double ck = coeffs[c][k], dk = coeffs[c][k]/jac;
+      for (int i=0; i < num; i++) {
+        u[c][i] += ck*t->fn[k][i];
+        dudx[c][i] += dk*t->der[k][i];
+      }
+    }
+  }
+
+  for (int f=0; f < n_func; f++) {
+    Functional *fc = &this->funcs[f];
+    int c = fc->comp;
+    double s = 0;
+    switch (fc->type) {
+      case -1:
+        s = fc->fn(num, x, w, u, dudx, fc->user_data);
+        break;
+      case FUNC_INTEGRAL:
+        for (int i=0; i < num; i++) s += u[c][i]*w[i];
+        break;
+      case FUNC_L2_NORM:
+        for (int i=0; i < num; i++) s += u[c][i]*u[c][i]*w[i];
+        break;
+      case FUNC_H1_SEMINORM:
+        for (int i=0; i < num; i++) s += dudx[c][i]*dudx[c][i]*w[i];
+        break;
+      case FUNC_H1_NORM:
+        for (int i=0; i < num; i++) 
+          s += (u[c][i]*u[c][i] + dudx[c][i]*dudx[c][i])*w[i];
+        break;
+      case FUNC_DER_LEFT:
+        if (m == 0) 
+          for (int k=0; k <= p; k++) s += coeffs[c][k]*lobatto_der_tab_1d[k](-1)/jac;
+        break;
+      case FUNC_DER_RIGHT:
+        if (m == this->mesh->get_n_elems() - 1) 
+          for (int k=0; k <= p; k++) s += coeffs[c][k]*lobatto_der_tab_1d[k](1)/jac;
+        break;
+    }
+    sums[f] += s;
+  }
+
+  // error norms, every exact solution is evaluated once per point
+  for (int ex=0; ex < (int) this->exact_fns.size(); ex++) {
+    double err[MAX_PTS_NUM][MAX_EQN_NUM], derr[MAX_PTS_NUM][MAX_EQN_NUM];
+    for (int i=0; i < num; i++) {
+      this->exact_fns[ex].fn(x[i], err[i], derr[i], this->exact_fns[ex].data);
+      for (int c=0; c < n_eq; c++) {
+        err[i][c] = u[c][i] - err[i][c];
+        derr[i][c] = dudx[c][i] - derr[i][c];
+      }
+    }
+    for (int f=0; f < n_func; f++) {
+      Functional *fc = &this->funcs[f];
+      if (fc->exact != ex) continue;
+      int c = fc->comp;
+      double s = 0;
+      for (int i=0; i < num; i++) {
+        double e2 = err[i][c]*err[i][c], de2 = derr[i][c]*derr[i][c];
+        if (fc->type == FUNC_L2_ERROR) s += e2*w[i];
+        else if (fc->type == FUNC_H1_SEMI_ERROR) s += de2*w[i];
+        else s += (e2 + de2)*w[i];
+      }
+      sums[f] += s;
+    }
+  }
+}
+
+struct Functionals::Worker {
+  Functionals *self;
+  double *y;
+  int first, last;
+  double *sums;
+};
+
+void *Functionals::worker(void *data)
+{
+  Worker *w = (Worker *) data;
+  for (int m=w->first; m < w->last; m++) w->self->evaluate_element(m, w->y, w->sums);
+  return NULL;
+}
+
+void Functionals::evaluate(double *y, double *results, int n_threads)
+{
+  int n_elem = this->mesh->get_n_elems();
+  int n_func = this->funcs.size();
+  Element *elems = this->mesh->get_elems();
+
+  // shape function tables of all quadratures needed in the mesh
+  for (int m=0; m < n_elem; m++) {
+    if (elems[m].p > MAX_LOBATTO_ORDER) 
+      error("element degree too high in Functionals::evaluate().");
+    int order = this->get_order(elems[m].p);
+    int num = g_quad_1d_std.get_num_points(order);
+    if (num > MAX_PTS_NUM) error("quadrature order too high in Functionals::evaluate().");
+    if (this->tables[num] != NULL) continue;
+    ShapeTable *t = new ShapeTable;
+    t->num = num;
+    t->pts = g_quad_1d_std.get_points(order);
+    t->weights = g_quad_1d_std.get_weights(order);
+    for (int k=0; k < MAX_LOBATTO_NUM; k++)
+      for (int i=0; i < num; i++) {
+        t->fn[k][i] = lobatto_fn_tab_1d[k](t->pts[i]);
+        t->der[k][i] = lobatto_der_tab_1d[k](t->pts[i]);
+      }
+    this->tables[num] = t;
+  }
+
+  if (n_threads < 1) n_threads = 1;
+  if (n_threads > n_elem) n_threads = n_elem;
+  Worker *workers = new Worker[n_threads];
+  pthread_t *threads = new pthread_t[n_threads];
+  for (int t=0; t < n_threads; t++) {
+    workers[t].self = this;
+    workers[t].y = y;
+    workers[t].first = (long) n_elem*t/n_threads;
+    workers[t].last = (long) n_elem*(t + 1)/n_threads;
+    workers[t].sums = new double[n_func];
+    for (int f=0; f < n_func; f++) workers[t].sums[f] = 0;
+  }
+  // the calling thread does the parts of the threads that cannot be
+  // created, and it waits for the others before reporting any error
+  int n_started = 0;
+  if (n_threads > 1)
+    while (n_started < n_threads && 
+           pthread_create(&threads[n_started], NULL, worker, workers + n_started) == 0)
+      n_started++;
+  std::string msg;
+  try {
+    for (int t=n_started; t < n_threads; t++) worker(workers + t);
+  }
+  catch (std::runtime_error &e) {
+    msg = e.what();
+  }
+  for (int t=0; t < n_started; t++) pthread_join(threads[t], NULL);
+  if (!msg.empty()) {
+    for (int t=0; t < n_threads; t++) delete [] workers[t].sums;
+    delete [] workers;
+    delete [] threads;
+    error(msg.c_str());
+  }
+
+  for (int f=0; f < n_func; f++) {
+    double s = 0;
+    for (int t=0; t < n_threads; t++) s += workers[t].sums[f];
+    int type = this->funcs[f].type;
+    if (type != -1 && type != FUNC_INTEGRAL && type != FUNC_DER_LEFT && 
+        type != FUNC_DER_RIGHT) s = sqrt(s);
+    results[f] = s;
+  }
+  for (int t=0; t < n_threads; t++) delete [] workers[t].sums;
+  delete [] workers;
+  delete [] threads;
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_FUNCTIONAL_H
+#define __HERMES1D_FUNCTIONAL_H
+
+#include <vector>
+
+#include "common.h"
+#include "lobatto.h"
+#include "quad_std.h"
+#include "mesh.h"
+#include "transfer.h"
+
+// built-in functionals of one solution component u (see Functionals)
+#define FUNC_INTEGRAL 0       // \int u
+#define FUNC_L2_NORM 1        // (\int u^2)^{1/2}
+#define FUNC_H1_SEMINORM 2    // (\int u'^2)^{1/2}
+#define FUNC_H1_NORM 3        // (\int u^2 + u'^2)^{1/2}
+#define FUNC_DER_LEFT 4       // u'(a), e.g. the flux through the left end point
+#define FUNC_DER_RIGHT 5      // u'(b)
+// the norms of the error u - u_exact, u_exact is given by a projection_fn
+#define FUNC_L2_ERROR 6
+#define FUNC_H1_SEMI_ERROR 7
+#define FUNC_H1_ERROR 8
+
+/// User-defined functional: returns the contribution of one element, i.e.
+/// the integrand summed over the quadrature points x with the weights
+/// (both in physical coordinates). u, dudx are the values and the
+/// derivatives of all solution components.
+typedef double (*functional_form)(int num, double *x, double *weights,
+        double u[MAX_EQN_NUM][MAX_PTS_NUM], double dudx[MAX_EQN_NUM][MAX_PTS_NUM],
+        void *user_data);
+
+/// Evaluates any number of functionals (quantities of interest) of a
+/// solution in a single sweep over the elements. The solution and its
+/// derivatives are evaluated once per quadrature point, from tables of the
+/// Lobatto shape functions at the points of every quadrature rule used,
+/// and all functionals are accumulated from them. The quadrature order in
+/// an element of degree p is the highest order requested by the
+/// functionals: 2p for the built-in ones, 2p + 4 for the error norms
+/// (the exact solution is not a polynomial) and order_mult*p + order_add
+/// for the user-defined ones. The elements can be split among threads.
+///
+/// Example:
+///
+///   Functionals f(mesh);
+///   int norm = f.add_builtin(FUNC_L2_NORM, 0);
+///   int err = f.add_builtin(FUNC_H1_ERROR, 0, exact_sol);
+///   double res[2];
+///   f.evaluate(y, res);
+class Functionals {
+public:
+    Functionals(Mesh *mesh);
+    ~Functionals();
+
+    // Adds the built-in functional 'type' (one of FUNC_*) of the solution
+    // component 'comp', the error norms need the exact solution. Returns
+    // the index of the functional in the results of evaluate().
+    int add_builtin(int type, int comp, projection_fn exact=NULL,
+                    void *exact_data=NULL);
+    // adds a user-defined functional, returns its index
+    int add_functional(functional_form fn, void *user_data=NULL,
+                       int order_mult=2, int order_add=0);
+    int get_num() {
+        return this->funcs.size();
+    }
+
+    // Evaluates all functionals of the solution y (length n_dof, the
+    // Dirichlet values are taken from the Mesh) into results[0..get_num()-1].
+    // The sums of the threads are added in a fixed order, so the results
+    // depend on n_threads only through rounding.
+    void evaluate(double *y, double *results, int n_threads=1);
+
+private:
+    struct Functional {
+        int type;             // FUNC_* or -1 for a user-defined functional
+        int comp;
+        int exact;            // index in exact_fns or -1
+        functional_form fn;
+        void *user_data;
+        int order_mult, order_add;
+    };
+    struct ExactFn {
+        projection_fn fn;
+        void *data;
+    };
+    // values of the Lobatto shape functions at the points of the Gauss
+    // rule with 'num' points
+    struct ShapeTable {
+        int num;
+        double *pts, *weights;
+        double fn[MAX_LOBATTO_NUM][MAX_PTS_NUM];
+        double der[MAX_LOBATTO_NUM][MAX_PTS_NUM];
+    };
+    struct Worker;
+
+    Mesh *mesh;
+    std::vector<Functional> funcs;
+    std::vector<ExactFn> exact_fns;
+    // indexed by the number of points, NULL if not needed yet
+    ShapeTable *tables[MAX_PTS_NUM + 1];
+
+    int get_order(int p);
+    void evaluate_element(int m, double *y, double *sums);
+    static void *worker(void *data);
+};
+
+#endif
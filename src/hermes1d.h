@@ -17,6 +17,17 @@
 #include "matrix.h"
 #include "quad_std.h"
 #include "lobatto.h"
+#include "operators.h"
 #include "discrete.h"
+#include "eigen.h"
+#include "timestep.h"
+#include "batch.h"
+#include "ensemble.h"
+#include "transfer.h"
+#include "nested.h"
+#include "writer.h"
+#include "checkpoint.h"
+#include "functional.h"
+#include "convergence.h"
 
 #endif
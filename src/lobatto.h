@@ -101,6 +101,9 @@
 
 //
 
+const int MAX_LOBATTO_ORDER = 11;                     // highest tabulated Lobatto shape function
+const int MAX_LOBATTO_NUM = MAX_LOBATTO_ORDER + 1;    // number of tabulated Lobatto shape functions
+
 extern shape_fn_t lobatto_fn_tab_1d[];
 extern shape_fn_t lobatto_der_tab_1d[];
 extern shape_fn_t legendre_fn_tab_1d[];
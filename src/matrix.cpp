@@ -108,3 +108,224 @@ void solve_linear_system(Matrix *mat, double *res)
     DenseMatrix *dmat = new DenseMatrix(mat);
     solve_linear_system_dense(dmat, res);
 }
+
+struct ColEntry {
+  int j;
+  double v;
+};
+
+static int compare_col_entries(const void *a, const void *b)
+{
+  return ((ColEntry *) a)->j - ((ColEntry *) b)->j;
+}
+
+void CSRMatrix::copy_from_coo_matrix(CooMatrix *m)
+{
+  int n = this->size = m->get_size();
+  // count the triples in every row
+  int *row_start = new int[n+1];
+  for (int i = 0; i <= n; i++) row_start[i] = 0;
+  int n_triples = 0;
+  for (Triple *t = m->get_list(); t != NULL; t = t->next) {
+    row_start[t->i+1]++;
+    n_triples++;
+  }
+  for (int i = 0; i < n; i++) row_start[i+1] += row_start[i];
+  // distribute the triples to their rows
+  ColEntry *entries = new ColEntry[n_triples > 0 ? n_triples : 1];
+  int *pos = new int[n];
+  for (int i = 0; i < n; i++) pos[i] = row_start[i];
+  for (Triple *t = m->get_list(); t != NULL; t = t->next) {
+    entries[pos[t->i]].j = t->j;
+    entries[pos[t->i]].v = t->v;
+    pos[t->i]++;
+  }
+  // sort every row by columns and sum the duplicates in place
+  this->IA = new int[n+1];
+  this->nnz = 0;
+  this->IA[0] = 0;
+  for (int i = 0; i < n; i++) {
+    ColEntry *row = entries + row_start[i];
+    int len = row_start[i+1] - row_start[i];
+    qsort(row, len, sizeof(ColEntry), compare_col_entries);
+    int k = 0;
+    while (k < len) {
+      int j = row[k].j;
+      double v = 0;
+      while (k < len && row[k].j == j) v += row[k++].v;
+      // same truncation as in copy_from_dense_matrix()
+      if (fabs(v) > 1e-12) {
+        entries[this->nnz].j = j;
+        entries[this->nnz].v = v;
+        this->nnz++;
+      }
+    }
+    this->IA[i+1] = this->nnz;
+  }
+  this->A = new double[this->nnz];
+  this->JA = new int[this->nnz];
+  for (int k = 0; k < this->nnz; k++) {
+    this->JA[k] = entries[k].j;
+    this->A[k] = entries[k].v;
+  }
+  delete [] entries;
+  delete [] pos;
+  delete [] row_start;
+}
+
+static double pythag(double a, double b)
+{
+  double absa = fabs(a), absb = fabs(b);
+  if (absa > absb) return absa*sqrt(1.0 + (absb/absa)*(absb/absa));
+  else return (absb == 0.0 ? 0.0 : absb*sqrt(1.0 + (absa/absb)*(absa/absb)));
+}
+
+void tqli(double *d, double *e, int n, double **z)
+{
+  int m, l, iter, i, k;
+  double s, r, p, g, f, dd, c, b;
+
+  for (i = 1; i < n; i++) e[i-1] = e[i];
+  e[n-1] = 0.0;
+  for (l = 0; l < n; l++)
+  {
+    iter = 0;
+    do
+    {
+      for (m = l; m < n-1; m++)
+      {
+        dd = fabs(d[m]) + fabs(d[m+1]);
+        if (fabs(e[m]) <= 1e-15*dd) break;
+      }
+      if (m != l)
+      {
+        if (iter++ == 60) error("Too many iterations in tqli.");
+        g = (d[l+1] - d[l]) / (2.0*e[l]);
+        r = pythag(g, 1.0);
+        g = d[m] - d[l] + e[l] / (g + (g >= 0 ? fabs(r) : -fabs(r)));
+        s = c = 1.0;
+        p = 0.0;
+        for (i = m-1; i >= l; i--)
+        {
+          f = s*e[i];
+          b = c*e[i];
+          e[i+1] = (r = pythag(f, g));
+          if (r == 0.0)
+          {
+            d[i+1] -= p;
+            e[m] = 0.0;
+            break;
+          }
+          s = f/r;
+          c = g/r;
+          g = d[i+1] - p;
+          r = (d[i] - g)*s + 2.0*c*b;
+          d[i+1] = g + (p = s*r);
+          g = c*r - b;
+          for (k = 0; k < n; k++)
+          {
+            f = z[k][i+1];
+            z[k][i+1] = s*z[k][i] + c*f;
+            z[k][i] = c*z[k][i] - s*f;
+          }
+        }
+        if (r == 0.0 && i >= l) continue;
+        d[l] -= p;
+        e[l] = g;
+        e[m] = 0.0;
+      }
+    } while (m != l);
+  }
+}
+
+void BandMatrix::mult_vector(double *x, double *y)
+{
+  int n = this->size;
+  int b = this->bandwidth;
+  double *xp = new double[n];
+  double *yp = new double[n];
+  for (int i = 0; i < n; i++) {
+    xp[this->perm != NULL ? this->perm[i] : i] = x[i];
+    yp[i] = 0;
+  }
+  for (int i = 0; i < n; i++) {
+    yp[i] += this->band[i][0]*xp[i];
+    for (int k = 1; k <= b && k <= i; k++) {
+      yp[i] += this->band[i][k]*xp[i-k];
+      yp[i-k] += this->band[i][k]*xp[i];
+    }
+  }
+  for (int i = 0; i < n; i++) y[i] = yp[this->perm != NULL ? this->perm[i] : i];
+  delete [] xp;
+  delete [] yp;
+}
+
+BandLDLT::BandLDLT(BandMatrix *A, BandMatrix *B, double sigma)
+{
+  int n = this->size = A->get_size();
+  int bw = this->bandwidth = A->get_bandwidth();
+  this->perm = A->get_perm();
+  if (B != NULL && (B->get_size() != n || B->get_perm() != this->perm))
+    error("matrices with different layouts in BandLDLT.");
+  double **a = A->get_band();
+  double **bb = B != NULL ? B->get_band() : NULL;
+  int b_bw = B != NULL ? B->get_bandwidth() : 0;
+  this->l = new_matrix<double>(n, bw+1);
+  this->d = new double[n];
+  this->tmp = new double[n];
+  this->num_negative = 0;
+  for (int i = 0; i < n; i++) {
+    for (int k = 0; k <= bw; k++) {
+      double v = a[i][k];
+      if (bb != NULL && k <= b_bw) v -= sigma*bb[i][k];
+      this->l[i][k] = v;
+    }
+  }
+  if (B != NULL && b_bw > bw) {
+    for (int i = 0; i < n; i++)
+      for (int k = bw+1; k <= b_bw; k++)
+        if (bb[i][k] != 0) error("B has a wider band than A in BandLDLT.");
+  }
+  // column-oriented LDL^T: l[i][k] holds the entry (i, i-k) of
+  // A - sigma B until the column j = i-k is processed, and L(i, j) after
+  // that (the diagonal of L is stored as 1, D separately)
+  for (int j = 0; j < n; j++) {
+    double dj = this->l[j][0];
+    for (int k = 1; k <= bw && k <= j; k++)
+      dj -= this->l[j][k]*this->l[j][k]*this->d[j-k];
+    if (dj == 0) dj = TINY;
+    this->d[j] = dj;
+    if (dj < 0) this->num_negative++;
+    for (int i = j+1; i <= j+bw && i < n; i++) {
+      double v = this->l[i][i-j];
+      for (int k = i-bw > 0 ? i-bw : 0; k < j; k++)
+        v -= this->l[i][i-k]*this->l[j][j-k]*this->d[k];
+      this->l[i][i-j] = v/dj;
+    }
+    this->l[j][0] = 1;
+  }
+}
+
+BandLDLT::~BandLDLT()
+{
+  delete [] (char *) this->l;
+  delete [] this->d;
+  delete [] this->tmp;
+}
+
+void BandLDLT::solve(double *b)
+{
+  int n = this->size;
+  int bw = this->bandwidth;
+  double *x = this->tmp;
+  for (int i = 0; i < n; i++) x[this->perm != NULL ? this->perm[i] : i] = b[i];
+  // L y = b
+  for (int i = 0; i < n; i++)
+    for (int k = 1; k <= bw && k <= i; k++) x[i] -= this->l[i][k]*x[i-k];
+  // D z = y
+  for (int i = 0; i < n; i++) x[i] /= this->d[i];
+  // L^T x = z
+  for (int i = n-1; i >= 0; i--)
+    for (int k = 1; k <= bw && i+k < n; k++) x[i] -= this->l[i+k][k]*x[i+k];
+  for (int i = 0; i < n; i++) b[i] = x[this->perm != NULL ? this->perm[i] : i];
+}
@@ -141,6 +141,14 @@ void cholsl(double **a, int n, double p[], T b[], T x[])
   }
 }
 
+/// Computes all eigenvalues and eigenvectors of a real symmetric tridiagonal matrix
+/// by the QL algorithm with implicit shifts. On input, d[n] contains the diagonal
+/// elements and e[n] the subdiagonal elements in e[1..n-1] (e[0] is arbitrary).
+/// On output, d[n] returns the eigenvalues and e is destroyed. If z[n][n] is input
+/// as the identity matrix, the k-th column of z returns the normalized eigenvector
+/// corresponding to d[k].
+void tqli(double *d, double *e, int n, double **z);
+
 class Matrix {
 public:
     virtual ~Matrix() { }
@@ -171,9 +179,19 @@ class CooMatrix : public Matrix {
     public:
         CooMatrix(int size) {
             this->size = size;
+            this->list = NULL;
+            this->list_last = NULL;
+        }
+        virtual ~CooMatrix() {
             this->zero();
         }
         virtual void zero() {
+            Triple *t = this->list;
+            while (t != NULL) {
+                Triple *next = t->next;
+                delete t;
+                t = next;
+            }
             this->list = NULL;
             this->list_last = NULL;
         }
@@ -215,6 +233,11 @@ class CooMatrix : public Matrix {
             }
         }
 
+        // Return the first triple of the list.
+        Triple *get_list() {
+            return this->list;
+        }
+
         virtual void print() {
             Triple *t = this->list;
             while (t != NULL) {
@@ -307,12 +330,20 @@ class DenseMatrix : public Matrix {
 class CSRMatrix : public Matrix {
     public:
         CSRMatrix(CooMatrix *m) {
-            DenseMatrix *dmat = new DenseMatrix(m);
-            this->copy_from_dense_matrix(dmat);
+            this->copy_from_coo_matrix(m);
         }
         CSRMatrix(DenseMatrix *m) {
             this->copy_from_dense_matrix(m);
         }
+        virtual ~CSRMatrix() {
+            delete [] this->A;
+            delete [] this->IA;
+            delete [] this->JA;
+        }
+
+        // Sorts the triples by rows and columns and sums the duplicate
+        // entries, in O(nnz log nnz) operations and memory.
+        void copy_from_coo_matrix(CooMatrix *m);
 
         void copy_from_dense_matrix(DenseMatrix *m) {
             this->size = m->get_size();
@@ -341,14 +372,35 @@ class CSRMatrix : public Matrix {
             }
         }
 
+        // Creates a matrix with the given sparsity pattern (the arrays are
+        // copied) and zero values. Entries can then be added in place.
+        CSRMatrix(int size, int nnz, int *IA, int *JA) {
+            this->size = size;
+            this->nnz = nnz;
+            this->A = new double[nnz];
+            this->IA = new int[size+1];
+            this->JA = new int[nnz];
+            memcpy(this->IA, IA, (size+1)*sizeof(int));
+            memcpy(this->JA, JA, nnz*sizeof(int));
+            this->zero();
+        }
+
         virtual void zero() {
-            error("Not implemented.");
+            for (int k = 0; k < this->nnz; k++) this->A[k] = 0;
         }
+        // the entry must be in the sparsity pattern (the column indices
+        // in every row are sorted)
         virtual void add(int m, int n, double v) {
-            error("Not implemented.");
+            int k = this->find(m, n);
+            if (k < 0) {
+                if (v == 0) return;
+                error("entry outside of the sparsity pattern of CSRMatrix.");
+            }
+            this->A[k] += v;
         }
         virtual double get(int m, int n) {
-            error("Not implemented.");
+            int k = this->find(m, n);
+            return (k < 0) ? 0 : this->A[k];
         }
 
         virtual int get_size() {
@@ -371,6 +423,9 @@ class CSRMatrix : public Matrix {
             printf("\n");
         }
 
+        int get_nnz() {
+            return this->nnz;
+        }
         int *get_IA() {
             return this->IA;
         }
@@ -388,6 +443,206 @@ class CSRMatrix : public Matrix {
         int *IA;
         int *JA;
 
+        // position of the entry (m, n) in A and JA, -1 if not present
+        int find(int m, int n) {
+            int lo = this->IA[m], hi = this->IA[m+1] - 1;
+            while (lo <= hi) {
+                int mid = (lo + hi)/2;
+                if (this->JA[mid] == n) return mid;
+                if (this->JA[mid] < n) lo = mid + 1;
+                else hi = mid - 1;
+            }
+            return -1;
+        }
+
+};
+
+/// Adds scale*v to the underlying matrix in add(). It allows assembling
+/// a linear combination of matrices, e.g. M/dt + J, into one matrix.
+class ScaledMatrix : public Matrix {
+    public:
+        ScaledMatrix(Matrix *mat, double scale) {
+            this->mat = mat;
+            this->scale = scale;
+        }
+        virtual void zero() {
+            this->mat->zero();
+        }
+        virtual void add(int m, int n, double v) {
+            this->mat->add(m, n, this->scale*v);
+        }
+        virtual double get(int m, int n) {
+            return this->scale*this->mat->get(m, n);
+        }
+        virtual int get_size() {
+            return this->mat->get_size();
+        }
+        virtual void copy_into(Matrix *m) {
+            error("Not implemented.");
+        }
+        virtual void print() {
+            this->mat->print();
+        }
+
+    private:
+        Matrix *mat;
+        double scale;
+};
+
+/// Diagonal matrix, e.g. the lumped mass matrix (OP_MASS_LUMPED). Adding
+/// a nonzero entry outside of the diagonal is an error.
+class DiagonalMatrix : public Matrix {
+    public:
+        DiagonalMatrix(int size) {
+            this->size = size;
+            this->diag = new double[size];
+            this->zero();
+        }
+        virtual ~DiagonalMatrix() {
+            delete [] this->diag;
+        }
+        virtual void zero() {
+            for (int i = 0; i < this->size; i++) this->diag[i] = 0;
+        }
+        virtual void add(int m, int n, double v) {
+            if (m == n) this->diag[m] += v;
+            else if (v != 0) error("off-diagonal entry added to DiagonalMatrix.");
+        }
+        virtual double get(int m, int n) {
+            return (m == n) ? this->diag[m] : 0;
+        }
+        virtual int get_size() {
+            return this->size;
+        }
+        virtual void copy_into(Matrix *m) {
+            m->zero();
+            for (int i = 0; i < this->size; i++)
+                if (this->diag[i] != 0) m->add(i, i, this->diag[i]);
+        }
+        virtual void print() {
+            for (int i = 0; i < this->size; i++) printf("%f\n", this->diag[i]);
+        }
+
+        // Return the diagonal.
+        double *get_diag() {
+            return this->diag;
+        }
+
+    private:
+        int size;
+        double *diag;
+};
+
+/// Symmetric band matrix. Only the lower band of half-bandwidth 'bandwidth'
+/// is stored; entries above the diagonal passed to add() are ignored, since
+/// they are the same as the ones below it. An optional permutation
+/// perm[i] (row/column 'i' of the assembled matrix is stored as row/column
+/// perm[i]) reduces the bandwidth of matrices assembled in the DOF numbering
+/// of the Mesh, see band_ordering() in eigen.h.
+class BandMatrix : public Matrix {
+    public:
+        BandMatrix(int size, int bandwidth, int *perm=NULL) {
+            this->size = size;
+            this->bandwidth = bandwidth;
+            this->perm = perm;
+            this->band = new_matrix<double>(size, bandwidth+1);
+            this->zero();
+        }
+        virtual ~BandMatrix() {
+            delete [] (char *) this->band;
+        }
+        virtual void zero() {
+            for(int i = 0; i < this->size; i++)
+                for(int j = 0; j <= this->bandwidth; j++)
+                    this->band[i][j] = 0;
+        }
+        virtual void add(int m, int n, double v) {
+            if (this->perm != NULL) {
+                m = this->perm[m];
+                n = this->perm[n];
+            }
+            if (m < n) return;
+            if (m - n > this->bandwidth) error("entry outside of the band in BandMatrix.");
+            this->band[m][m-n] += v;
+        }
+        virtual double get(int m, int n) {
+            if (this->perm != NULL) {
+                m = this->perm[m];
+                n = this->perm[n];
+            }
+            if (m < n) {
+                int t = m; m = n; n = t;
+            }
+            if (m - n > this->bandwidth) return 0;
+            return this->band[m][m-n];
+        }
+
+        virtual int get_size() {
+            return this->size;
+        }
+        virtual void copy_into(Matrix *m) {
+            m->zero();
+            for (int i = 0; i < this->size; i++)
+                for (int j = 0; j < this->size; j++) {
+                    double v = this->get(i, j);
+                    if (v != 0) m->add(i, j, v);
+                }
+        }
+        virtual void print() {
+            for (int i = 0; i < this->size; i++) {
+                for (int j = 0; j <= this->bandwidth; j++)
+                    printf("%f ", this->band[i][j]);
+                printf("\n");
+            }
+        }
+
+        // y = M*x, both vectors in the numbering of the assembled matrix
+        void mult_vector(double *x, double *y);
+
+        int get_bandwidth() {
+            return this->bandwidth;
+        }
+        int *get_perm() {
+            return this->perm;
+        }
+        // Return the internal storage, band[i][k] is the entry (i, i-k).
+        double **get_band() {
+            return this->band;
+        }
+
+    private:
+        int size;
+        int bandwidth;
+        int *perm;
+        double **band;
+};
+
+/// LDL^T factorization of the shifted symmetric band matrix A - sigma*B
+/// (B may be NULL). The factorization is done without pivoting, so
+/// A - sigma*B must not have a singular leading submatrix. By Sylvester's
+/// law of inertia, the number of negative entries of D equals the number
+/// of eigenvalues of A x = lambda B x below sigma (for B positive definite).
+class BandLDLT {
+    public:
+        BandLDLT(BandMatrix *A, BandMatrix *B=NULL, double sigma=0);
+        ~BandLDLT();
+
+        // Solves (A - sigma*B) x = b, b is overwritten by x. The vector
+        // is in the numbering of the assembled matrices.
+        void solve(double *b);
+        // number of negative pivots (eigenvalues below sigma)
+        int get_num_negative() {
+            return this->num_negative;
+        }
+
+    private:
+        int size;
+        int bandwidth;
+        int *perm;
+        double **l;     // unit lower band factor, l[i][k] is L(i, i-k)
+        double *d;
+        double *tmp;
+        int num_negative;
 };
 
 // solve linear system
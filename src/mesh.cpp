@@ -3,10 +3,15 @@
 // file for the exact terms).
 // Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
 
+#include <math.h>
+#include <algorithm>
+
 #include "mesh.h"
+#include "writer.h"
 
 void Mesh::create(double a, double b, int n_elem)
 {
+  this->revision++;
   this->n_elem = n_elem;
   this->vertices = new Vertex[this->n_elem+1]; // allocate array of vertices
   double h = (b - a)/this->n_elem;
@@ -22,10 +27,22 @@ void Mesh::create(double a, double b, int n_elem)
   }
 }
 
+int Mesh::find_element(double x)
+{
+  int lo = 0, hi = this->n_elem - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1)/2;
+    if (this->vertices[mid].x <= x) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
 // sets uniform polynomial degrees in the mesh
 // and allocates elememnt dof arrays
 void Mesh::set_uniform_poly_order(int poly_order)
 {
+  this->revision++;
   for(int i=0; i < this->n_elem; i++) {
     this->elems[i].p = poly_order;
     // c is solution component
@@ -35,8 +52,22 @@ void Mesh::set_uniform_poly_order(int poly_order)
   }
 }
 
+// sets the polynomial degree of every element
+// and allocates element dof arrays
+void Mesh::set_poly_orders(int *poly_orders)
+{
+  this->revision++;
+  for(int i=0; i < this->n_elem; i++) {
+    this->elems[i].p = poly_orders[i];
+    for(int c=0; c<this->n_eq; c++) {
+      this->elems[i].dof[c] = new int[poly_orders[i]+1];
+    }
+  }
+}
+
 int Mesh::assign_dofs()
 {
+  this->revision++;
   // define element connectivities
   // (so far only for zero Dirichlet conditions)
   // (a) enumerate vertex dofs
@@ -95,17 +126,20 @@ int Mesh::assign_dofs()
 // return coefficients for all shape functions on the element m,
 // for all solution components
 void Mesh::calculate_elem_coeffs(int m, double *y_prev, 
-                                 double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM])
+                                 double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM],
+                                 double *bc_left, double *bc_right)
 {
+  if (bc_left == NULL) bc_left = bc_left_dir_values;
+  if (bc_right == NULL) bc_right = bc_right_dir_values;
   for(int c=0; c<n_eq; c++) {
     if (m == 0 && elems[m].dof[c][0] == -1) {
-        coeffs[c][0] = bc_left_dir_values[c];
+        coeffs[c][0] = bc_left[c];
     }
     else {
         coeffs[c][0] = y_prev[elems[m].dof[c][0]];
     }
     if (m == n_elem-1 && elems[m].dof[c][1] == -1) {
-        coeffs[c][1] = bc_right_dir_values[c];
+        coeffs[c][1] = bc_right[c];
     }
     else {
         coeffs[c][1] = y_prev[elems[m].dof[c][1]];
@@ -157,17 +191,17 @@ void Mesh::element_solution_point(double x_ref, Element *e,
   }
 } 
 
-// transformation of k-th shape function defined on Gauss points 
-// corresponding to 'order' to physical interval (a,b)
+// transformation of k-th shape function defined on the points of
+// the quadrature 'quad' corresponding to 'order' to physical interval (a,b)
 void Mesh::element_shapefn(double a, double b, 
-		     int k, int order, double *val, double *der) {
-  double2 *ref_tab = g_quad_1d_std.get_points(order);
-  int pts_num = g_quad_1d_std.get_num_points(order);
+		     int k, int order, double *val, double *der, Quad1D *quad) {
+  double *ref_pts = quad->get_points(order);
+  int pts_num = quad->get_num_points(order);
   for (int i=0 ; i<pts_num; i++) {
     // change function values and derivatives to interval (a, b)
-    val[i] = lobatto_fn_tab_1d[k](ref_tab[i][0]);
+    val[i] = lobatto_fn_tab_1d[k](ref_pts[i]);
     double jac = (b-a)/2.; 
-    der[i] = lobatto_der_tab_1d[k](ref_tab[i][0]) / jac; 
+    der[i] = lobatto_der_tab_1d[k](ref_pts[i]) / jac; 
   }
 };
 
@@ -183,23 +217,27 @@ void Mesh::element_shapefn_point(double x_ref, double a, double b,
 
 void Mesh::set_bc_left_dirichlet(int eq_n, double val)
 {
+    this->revision++;
     this->bc_left_dir[eq_n] = 1;
     this->bc_left_dir_values[eq_n] = val;
 }
 
 void Mesh::set_bc_right_dirichlet(int eq_n, double val)
 {
+    this->revision++;
     this->bc_right_dir[eq_n] = 1;
     this->bc_right_dir_values[eq_n] = val;
 }
 
 void Mesh::set_bc_left_natural(int eq_n)
 {
+    this->revision++;
     this->bc_left_dir[eq_n] = 0;
 }
 
 void Mesh::set_bc_right_natural(int eq_n)
 {
+    this->revision++;
     this->bc_right_dir[eq_n] = 0;
 }
 
@@ -224,56 +262,66 @@ void Linearizer::eval_approx(Element *e, double x_ref, double *y,
 // Plot solution in Gnuplot format
 void Linearizer::plot_solution(const char *out_filename, 
                                double *y_prev, int plotting_elem_subdivision)
+{
+  this->save_solution(out_filename, y_prev, OUT_GNUPLOT, plotting_elem_subdivision);
+}
+
+void Linearizer::save_solution(const char *out_filename, double *y_prev, 
+                               int format, int plotting_elem_subdivision)
+{
+  SolutionWriter *w = new_solution_writer(format, out_filename);
+  try {
+    this->write_solution(w, y_prev, plotting_elem_subdivision);
+  }
+  catch (std::runtime_error &e) {
+    delete w;
+    throw;
+  }
+  delete w;
+}
+
+void Linearizer::write_solution(SolutionWriter *w, double *y_prev, 
+                                int plotting_elem_subdivision)
 {
   int n_eq = this->mesh->get_n_eq();
   int n_elem = this->mesh->get_n_elems();  
   Element *elems = this->mesh->get_elems();
-  // FIXME:
-  if(n_eq > MAX_EQN_NUM)
-      error("number of equations too high in plot_solution().");
-  FILE *f[MAX_EQN_NUM];
-  char final_filename[MAX_EQN_NUM][MAX_STRING_LENGTH];
-  for(int c=0; c<n_eq; c++) {
-    if(n_eq == 1) sprintf(final_filename[c], "%s", out_filename);
-    else sprintf(final_filename[c], "%s_%d", out_filename, c);
-    f[c] = fopen(final_filename[c], "wb");
-    if(f[c] == NULL) error("problem opening file in plot_solution().");
-  }
-  // FIXME
-  if(plotting_elem_subdivision > 100) 
-  error ("plotting_elem_subdivision too high in plot_solution()."); 
+  if(plotting_elem_subdivision < 1) 
+    error("plotting_elem_subdivision too low in write_solution().");
   double phys_u_prev[MAX_EQN_NUM][MAX_PTS_NUM];
   double phys_du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM];
+  double x[MAX_PTS_NUM], val[MAX_PTS_NUM*MAX_EQN_NUM];
+  w->begin(n_eq);
   for(int m=0; m<n_elem; m++) {
-    // FIXME:
-    if(elems[m].p > 90) error ("element degree too hign in plot(solution)."); 
+    if(elems[m].p > MAX_LOBATTO_ORDER) 
+      error("element degree too high in write_solution()."); 
     double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
     this->mesh->calculate_elem_coeffs(m, y_prev, coeffs); 
-
-    double pts_array[MAX_PTS_NUM];
-    double h = 2./plotting_elem_subdivision;
-
-    for (int j=0; j<plotting_elem_subdivision+1; j++) pts_array[j] = -1 + j*h;
-    this->mesh->element_solution(elems + m, coeffs, plotting_elem_subdivision+1, 
-                       pts_array, phys_u_prev, phys_du_prevdx); 
     double a = elems[m].v1->x;
     double b = elems[m].v2->x;
-    // loop over solution components
-    for(int c=0; c<n_eq; c++) {
-      for (int j=0; j<plotting_elem_subdivision+1; j++) {
-        fprintf(f[c], "%g %g\n", (a + b)/2  
-                + pts_array[j] * (b-a)/2, phys_u_prev[c][j]);
+    double h = 2./plotting_elem_subdivision;
+
+    // the points of the element in blocks of at most MAX_PTS_NUM
+    for (int j0=0; j0<plotting_elem_subdivision+1; j0+=MAX_PTS_NUM) {
+      int n = plotting_elem_subdivision+1 - j0;
+      if (n > MAX_PTS_NUM) n = MAX_PTS_NUM;
+      double pts_array[MAX_PTS_NUM];
+      for (int j=0; j<n; j++) pts_array[j] = -1 + (j0 + j)*h;
+      this->mesh->element_solution(elems + m, coeffs, n, 
+                         pts_array, phys_u_prev, phys_du_prevdx); 
+      for (int j=0; j<n; j++) {
+        x[j] = (a + b)/2 + pts_array[j] * (b-a)/2;
+        for(int c=0; c<n_eq; c++) val[j*n_eq + c] = phys_u_prev[c][j];
       }
+      w->write(n, x, val);
     }
   }
-  for(int c=0; c<n_eq; c++) {
-    printf("Output written to %s.\n", final_filename[c]);
-    fclose(f[c]);
-  }
+  w->end();
 }
 
 // Returns pointers to x and y coordinates in **x and **y
-// you should free it yourself when you don't need it anymore
+// you should free them yourself (delete []) when you don't need them anymore;
+// eval_solution() fills caller-provided buffers instead
 // y_prev --- the solution coefficients (all equations)
 // comp --- which component you want to process
 // plotting_elem_subdivision --- the number of subdivision of the element
@@ -285,45 +333,239 @@ void Linearizer::get_xy(double *y_prev, int comp,
         double **x, double **y, int *n)
 {
     int n_eq = this->mesh->get_n_eq();
-    int n_elem = this->mesh->get_n_elems();
-    Element *elems = this->mesh->get_elems();
-
-    *n = n_elem * (plotting_elem_subdivision+1);
+    if(comp < 0 || comp >= n_eq)
+        error("wrong solution component in get_xy().");
+    *n = this->get_n_points(plotting_elem_subdivision);
     double *x_out = new double[*n];
     double *y_out = new double[*n];
-
-    // FIXME:
-    if(n_eq > MAX_EQN_NUM)
-        error("number of equations too high in plot_solution().");
-    // FIXME
-    if(plotting_elem_subdivision > MAX_PTS_NUM)
-        error("plotting_elem_subdivision too high in plot_solution().");
-    double phys_u_prev[MAX_EQN_NUM][MAX_PTS_NUM];
-    double phys_du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM];
-    for(int m=0; m<n_elem; m++) {
-        // FIXME:
-        if(elems[m].p > 90)
-            error("element degree too hign in plot(solution).");
-        double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
-        this->mesh->calculate_elem_coeffs(m, y_prev, coeffs);
-
-        double pts_array[MAX_PTS_NUM];
-        double h = 2./plotting_elem_subdivision;
-
-        for (int j=0; j<plotting_elem_subdivision+1; j++)
-            pts_array[j] = -1 + j*h;
-        this->mesh->element_solution(elems + m, coeffs,
-                plotting_elem_subdivision+1, pts_array,
-                phys_u_prev, phys_du_prevdx);
-        double a = elems[m].v1->x;
-        double b = elems[m].v2->x;
-        for (int j=0; j<plotting_elem_subdivision+1; j++) {
-            x_out[m*(plotting_elem_subdivision+1) + j] =
-                (a + b)/2 + pts_array[j] * (b-a)/2;
-            y_out[m*(plotting_elem_subdivision+1) + j] =
-                phys_u_prev[comp][j];
-        }
+    if(n_eq == 1) 
+        this->eval_solution(y_prev, plotting_elem_subdivision, x_out, 1, 
+                            y_out, 1, 1);
+    else {
+        // eval_solution() evaluates all components
+        double *val = new double[*n*n_eq];
+        this->eval_solution(y_prev, plotting_elem_subdivision, x_out, 1, 
+                            val, n_eq, 1);
+        for(int i=0; i<*n; i++) y_out[i] = val[i*n_eq + comp];
+        delete [] val;
     }
     *x = x_out;
     *y = y_out;
 }
+
+int Linearizer::get_n_points(int plotting_elem_subdivision)
+{
+  return this->mesh->get_n_elems()*(plotting_elem_subdivision + 1);
+}
+
+void Linearizer::eval_solution(double *y_prev, int plotting_elem_subdivision,
+                               double *x, int x_stride, double *val, int pt_stride, 
+                               int comp_stride, double *der)
+{
+  int n_eq = this->mesh->get_n_eq();
+  int n_elem = this->mesh->get_n_elems();
+  Element *elems = this->mesh->get_elems();
+  if(plotting_elem_subdivision < 1) 
+    error("plotting_elem_subdivision too low in eval_solution().");
+  double phys_u_prev[MAX_EQN_NUM][MAX_PTS_NUM];
+  double phys_du_prevdx[MAX_EQN_NUM][MAX_PTS_NUM];
+  long i = 0;   // index of the point
+  for(int m=0; m<n_elem; m++) {
+    if(elems[m].p > MAX_LOBATTO_ORDER) 
+      error("element degree too high in eval_solution()."); 
+    double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+    this->mesh->calculate_elem_coeffs(m, y_prev, coeffs); 
+    double a = elems[m].v1->x;
+    double b = elems[m].v2->x;
+    double h = 2./plotting_elem_subdivision;
+
+    // the same points as write_solution(), in blocks of MAX_PTS_NUM
+    for (int j0=0; j0<plotting_elem_subdivision+1; j0+=MAX_PTS_NUM) {
+      int n = plotting_elem_subdivision+1 - j0;
+      if (n > MAX_PTS_NUM) n = MAX_PTS_NUM;
+      double pts_array[MAX_PTS_NUM];
+      for (int j=0; j<n; j++) pts_array[j] = -1 + (j0 + j)*h;
+      this->mesh->element_solution(elems + m, coeffs, n, 
+                         pts_array, phys_u_prev, phys_du_prevdx); 
+      for (int j=0; j<n; j++, i++) {
+        if (x != NULL) x[i*x_stride] = (a + b)/2 + pts_array[j] * (b-a)/2;
+        for(int c=0; c<n_eq; c++) {
+          val[i*pt_stride + c*comp_stride] = phys_u_prev[c][j];
+          if (der != NULL) der[i*pt_stride + c*comp_stride] = phys_du_prevdx[c][j];
+        }
+      }
+    }
+  }
+}
+
+void Linearizer::eval_point(double *y_prev, double x, double *val, double *der)
+{
+  this->eval_points(y_prev, 1, &x, val, der);
+}
+
+void Linearizer::eval_points(double *y_prev, int n_pts, double *x, double *val, 
+                             double *der)
+{
+  int n_eq = this->mesh->get_n_eq();
+  int n_elem = this->mesh->get_n_elems();
+  Element *elems = this->mesh->get_elems();
+  double a = elems[0].v1->x, b = elems[n_elem-1].v2->x;
+  bool sorted = true;
+  for (int i=0; i < n_pts; i++) {
+    if (x[i] < a || x[i] > b) error("point outside of the mesh in eval_points().");
+    if (i > 0 && x[i] < x[i-1]) sorted = false;
+  }
+
+  double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  double der_tmp[MAX_EQN_NUM];
+  int m = 0, m_coeffs = -1;
+  for (int i=0; i < n_pts; i++) {
+    if (sorted) {
+      while (m < n_elem - 1 && elems[m].v2->x <= x[i]) m++;
+    }
+    else m = this->mesh->find_element(x[i]);
+    // consecutive points in one element share the coefficients
+    if (m != m_coeffs) {
+      this->mesh->calculate_elem_coeffs(m, y_prev, coeffs);
+      m_coeffs = m;
+    }
+    double ea = elems[m].v1->x, eb = elems[m].v2->x;
+    this->mesh->element_solution_point((2*x[i] - ea - eb)/(eb - ea), elems + m, coeffs, 
+                                       val + i*n_eq, der != NULL ? der + i*n_eq : der_tmp);
+  }
+}
+
+// block of sampled points passed to a SolutionWriter
+struct SampleBuffer {
+  SolutionWriter *w;
+  int n_eq, n;
+  double x[MAX_PTS_NUM];
+  double val[MAX_PTS_NUM*MAX_EQN_NUM];
+};
+
+static void sample_point(SampleBuffer *buf, double x, double *val)
+{
+  if (buf->n == MAX_PTS_NUM) {
+    buf->w->write(buf->n, buf->x, buf->val);
+    buf->n = 0;
+  }
+  buf->x[buf->n] = x;
+  for (int c=0; c < buf->n_eq; c++) buf->val[buf->n*buf->n_eq + c] = val[c];
+  buf->n++;
+}
+
+// samples the segment (xa, xb) of the reference element, whose end values
+// ua, ub are known; writes the points after xa up to xb, bisecting at
+// most 'level' more times
+static void sample_segment(Mesh *mesh, Element *e, double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM],
+                           double xa, double *ua, double xb, double *ub, 
+                           double tol, int level, SampleBuffer *buf)
+{
+  int n_eq = buf->n_eq;
+  double a = e->v1->x, b = e->v2->x;
+  if (level == 0) {
+    sample_point(buf, (a + b)/2 + xb*(b - a)/2, ub);
+    return;
+  }
+  double der[MAX_EQN_NUM];
+  double um[MAX_EQN_NUM], u1[MAX_EQN_NUM], u3[MAX_EQN_NUM];
+  double xm = (xa + xb)/2;
+  mesh->element_solution_point(xm, e, coeffs, um, der);
+  mesh->element_solution_point((3*xa + xb)/4, e, coeffs, u1, der);
+  mesh->element_solution_point((xa + 3*xb)/4, e, coeffs, u3, der);
+  double err = 0;
+  for (int c=0; c < n_eq; c++) {
+    err = std::max(err, fabs(um[c] - (ua[c] + ub[c])/2));
+    err = std::max(err, fabs(u1[c] - (3*ua[c] + ub[c])/4));
+    err = std::max(err, fabs(u3[c] - (ua[c] + 3*ub[c])/4));
+  }
+  if (err <= tol) {
+    sample_point(buf, (a + b)/2 + xb*(b - a)/2, ub);
+    return;
+  }
+  sample_segment(mesh, e, coeffs, xa, ua, xm, um, tol, level - 1, buf);
+  sample_segment(mesh, e, coeffs, xm, um, xb, ub, tol, level - 1, buf);
+}
+
+void Linearizer::write_solution_adaptive(SolutionWriter *w, double *y_prev, 
+                                         double tol, int max_level)
+{
+  int n_eq = this->mesh->get_n_eq();
+  int n_elem = this->mesh->get_n_elems();  
+  Element *elems = this->mesh->get_elems();
+  if (tol <= 0) error("tolerance must be positive in write_solution_adaptive().");
+  SampleBuffer buf;
+  buf.w = w;
+  buf.n_eq = n_eq;
+  buf.n = 0;
+  w->begin(n_eq);
+  double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  double ua[MAX_EQN_NUM], ub[MAX_EQN_NUM], der[MAX_EQN_NUM];
+  for (int m=0; m < n_elem; m++) {
+    Element *e = elems + m;
+    if (e->p > MAX_LOBATTO_ORDER) 
+      error("element degree too high in write_solution_adaptive()."); 
+    this->mesh->calculate_elem_coeffs(m, y_prev, coeffs);
+    this->mesh->element_solution_point(-1, e, coeffs, ua, der);
+    if (m == 0) sample_point(&buf, e->v1->x, ua);
+    // initial subdivision into p equal segments (only a starting point,
+    // it does not isolate the inflection points), which are then bisected
+    // where the linear interpolation is not accurate enough
+    int n_seg = (e->p > 1) ? e->p : 1;
+    for (int s=0; s < n_seg; s++) {
+      double xb = -1 + 2.*(s + 1)/n_seg;
+      this->mesh->element_solution_point(xb, e, coeffs, ub, der);
+      sample_segment(this->mesh, e, coeffs, -1 + 2.*s/n_seg, ua, xb, ub, 
+                     tol, max_level, &buf);
+      for (int c=0; c < n_eq; c++) ua[c] = ub[c];
+    }
+  }
+  if (buf.n > 0) w->write(buf.n, buf.x, buf.val);
+  w->end();
+}
+
+void Linearizer::save_solution_adaptive(const char *out_filename, double *y_prev, 
+                                        int format, double tol, int max_level)
+{
+  SolutionWriter *w = new_solution_writer(format, out_filename);
+  try {
+    this->write_solution_adaptive(w, y_prev, tol, max_level);
+  }
+  catch (std::runtime_error &e) {
+    delete w;
+    throw;
+  }
+  delete w;
+}
+
+// writer collecting the points of one component
+class ComponentCollector : public SolutionWriter {
+public:
+  ComponentCollector(int comp) { this->comp = comp; }
+  virtual void begin(int n_eq) { this->n_eq = n_eq; }
+  virtual void write(int n, double *x, double *val) {
+    for (int i=0; i < n; i++) {
+      this->x.push_back(x[i]);
+      this->y.push_back(val[i*this->n_eq + this->comp]);
+    }
+  }
+  virtual void end() {}
+  int comp, n_eq;
+  std::vector<double> x, y;
+};
+
+void Linearizer::get_xy_adaptive(double *y_prev, int comp, double tol,
+                                 double **x, double **y, int *n, int max_level)
+{
+  if (comp < 0 || comp >= this->mesh->get_n_eq()) 
+    error("wrong solution component in get_xy_adaptive().");
+  ComponentCollector cc(comp);
+  this->write_solution_adaptive(&cc, y_prev, tol, max_level);
+  *n = cc.x.size();
+  *x = new double[*n];
+  *y = new double[*n];
+  for (int i=0; i < *n; i++) {
+    (*x)[i] = cc.x[i];
+    (*y)[i] = cc.y[i];
+  }
+}
@@ -24,14 +24,11 @@ public:
 class Mesh {
     public:
         Mesh(int n_eq) {
-            // Print the banner (only once)
-            static int n_calls = 0;
-            n_calls++;
-            if (n_calls == 1) intro();
             // check maximum number of equations
             if(n_eq > MAX_EQN_NUM) 
               error("Maximum number of equations exceeded (set in common.h)");
             this->n_eq = n_eq;
+            this->revision = 0;
             this->bc_left_dir = new int[n_eq];
             this->bc_left_dir_values = new double[n_eq];
             this->bc_right_dir = new int[n_eq];
@@ -45,6 +42,8 @@ class Mesh {
         }
         void create(double a, double b, int n_elem);
         void set_uniform_poly_order(int poly_order);
+        // degree poly_orders[m] in the element m
+        void set_poly_orders(int *poly_orders);
         int assign_dofs();
         Vertex *get_vertices() {
             return this->vertices;
@@ -61,14 +60,33 @@ class Mesh {
         int get_n_eq() {
             return this->n_eq;
         }
-        void calculate_elem_coeffs(int m, double *y_prev, double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM]);
+        // Counter increased by every change of the mesh through its
+        // methods (create(), degrees, boundary conditions, assign_dofs()),
+        // so that cached data (e.g. of DiscreteProblem) can detect that it
+        // is out of date. Call mark_modified() after moving the vertices
+        // through get_vertices().
+        int get_revision() {
+            return this->revision;
+        }
+        void mark_modified() {
+            this->revision++;
+        }
+        // index of the element containing the point x (binary search in
+        // the sorted vertices, the last element for x = b); x outside of
+        // the mesh gives the first or the last element
+        int find_element(double x);
+        // the Dirichlet values bc_left, bc_right (length n_eq) replace
+        // the values set in the mesh if they are not NULL
+        void calculate_elem_coeffs(int m, double *y_prev, double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM],
+                                   double *bc_left=NULL, double *bc_right=NULL);
         void element_solution(Element *e, double coeff[MAX_EQN_NUM][MAX_COEFFS_NUM], int pts_num, 
 		      double pts_array[MAX_PTS_NUM], double val[MAX_EQN_NUM][MAX_PTS_NUM], 
                       double der[MAX_EQN_NUM][MAX_PTS_NUM]);
         void element_solution_point(double x_ref, Element *e, 
 			    double coeff[MAX_EQN_NUM][MAX_COEFFS_NUM], double *val, double *der);
         void element_shapefn(double a, double b, 
-			     int k, int order, double *val, double *der);
+			     int k, int order, double *val, double *der,
+                             Quad1D *quad=&g_quad_1d_std);
         void element_shapefn_point(double x_ref, double a, double b, 
 				   int k, double *val, double *der);
         void set_bc_left_dirichlet(int eq_n, double val);
@@ -91,11 +109,14 @@ class Mesh {
         int n_eq;
         int n_elem;
         int n_dof;
+        int revision;
         Vertex *vertices;
         Element *elems;
 
 };
 
+class SolutionWriter;
+
 class Linearizer {
     public:
         Linearizer(Mesh *mesh) {
@@ -107,14 +128,57 @@ class Linearizer {
         void eval_approx(Element *e, double x_ref, double *y, double *x_phys,
 			 double *val);
 
+        // Gnuplot output, the same as save_solution(..., OUT_GNUPLOT, ...)
         void plot_solution(const char *out_filename, double *y_prev, int
-                // FIXME: code needs to be fixed to allow
-                // plotting_elem_subdivision to be 100 and more
                 plotting_elem_subdivision=50);
 
+        // output in the format 'format' (one of OUT_*, see writer.h); every
+        // element is sampled at plotting_elem_subdivision+1 equidistant points
+        void save_solution(const char *out_filename, double *y_prev, int format,
+                int plotting_elem_subdivision=50);
+        // the same points passed to the writer 'w'
+        void write_solution(SolutionWriter *w, double *y_prev, 
+                int plotting_elem_subdivision=50);
+
         void get_xy(double *y_prev, int comp, int plotting_elem_subdivision,
                 double **x, double **y, int *n);
 
+        // number of points sampled by get_xy() and eval_solution()
+        int get_n_points(int plotting_elem_subdivision);
+        // Evaluates all solution components (and their derivatives if der
+        // is not NULL) at the points of get_xy() in one pass, into buffers
+        // provided by the caller (e.g. NumPy arrays): the point i goes to
+        // x[i*x_stride] (x may be NULL) and the component c to
+        // val[i*pt_stride + c*comp_stride], der[i*pt_stride + c*comp_stride].
+        // The strides are in doubles. Nothing is allocated.
+        void eval_solution(double *y_prev, int plotting_elem_subdivision,
+                double *x, int x_stride, double *val, int pt_stride, 
+                int comp_stride, double *der=NULL);
+
+        // Adaptive sampling: every element is split into p segments, which
+        // are bisected (at most max_level times) until the linear
+        // interpolation of every component between the sampled points is
+        // within 'tol' of the solution (checked at the midpoint and the
+        // quarter points of each segment). Vertices are written once.
+        void write_solution_adaptive(SolutionWriter *w, double *y_prev, 
+                double tol, int max_level=12);
+        void save_solution_adaptive(const char *out_filename, double *y_prev, 
+                int format, double tol, int max_level=12);
+        // the adaptive points of one component, like get_xy()
+        void get_xy_adaptive(double *y_prev, int comp, double tol,
+                double **x, double **y, int *n, int max_level=12);
+
+        // values val[c] and derivatives der[c] (if not NULL) of all solution
+        // components at the physical point x (Dirichlet values included)
+        void eval_point(double *y_prev, double x, double *val, double *der=NULL);
+
+        // the same for the points x[0], ..., x[n_pts-1], the results are
+        // stored by points: val[i*n_eq + c], der[i*n_eq + c] (der may be
+        // NULL). Sorted points are located by one merge walk through the
+        // elements (linear time), unsorted ones by binary search.
+        void eval_points(double *y_prev, int n_pts, double *x, double *val, 
+                         double *der=NULL);
+
     private:
         Mesh *mesh;
 };
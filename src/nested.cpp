@@ -0,0 +1,84 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <math.h>
+#include <string.h>
+
+#include "nested.h"
+#include "batch.h"
+
+int solve_newton(DiscreteProblem *dp, Solver *solver, double *y, 
+                 double tol, int max_iter, double *assembly_time, double *solve_time)
+{
+  Mesh *mesh = dp->get_mesh();
+  int n = mesh->get_n_dof();
+  int nnz, *IA, *JA;
+  build_element_pattern(mesh, &nnz, &IA, &JA);
+  CSRMatrix mat(n, nnz, IA, JA);
+  delete [] IA;
+  delete [] JA;
+  std::vector<double> res(n), vec(n);
+  SolverContexts contexts(solver);
+  void *ctx = contexts.get();
+
+  int iter = -1;
+  double t_assembly = 0, t_solve = 0;
+  double t0 = get_wall_time();
+  bool ok = solver->analyze(ctx, n, mat.get_IA(), mat.get_JA(), mat.get_A(), false);
+  t_solve += get_wall_time() - t0;
+  for (int it=0; ok; it++) {
+    t0 = get_wall_time();
+    mat.zero();
+    dp->assemble_matrix_and_vector(&mat, &res[0], y);
+    t_assembly += get_wall_time() - t0;
+    double res_norm = 0;
+    for (int i=0; i < n; i++) res_norm += res[i]*res[i];
+    res_norm = sqrt(res_norm);
+    if (res_norm < tol) {
+      iter = it;
+      break;
+    }
+    if (it >= max_iter) break;
+
+    for (int i=0; i < n; i++) res[i] *= -1;
+    t0 = get_wall_time();
+    ok = solver->factorize(ctx, n, mat.get_IA(), mat.get_JA(), mat.get_A(), false) &&
+         solver->solve(ctx, n, mat.get_IA(), mat.get_JA(), mat.get_A(), false, 
+                       &res[0], &vec[0]);
+    t_solve += get_wall_time() - t0;
+    if (ok) for (int i=0; i < n; i++) y[i] += vec[i];
+  }
+
+  if (assembly_time != NULL) *assembly_time += t_assembly;
+  if (solve_time != NULL) *solve_time += t_solve;
+  return iter;
+}
+
+int solve_nested(DiscreteProblem *dp, Mesh **meshes, int n_levels, Solver *solver,
+                 double *y, int *iters, double tol, int max_iter)
+{
+  if (n_levels < 1) error("no levels in solve_nested().");
+  if (solver->is_row_oriented()) 
+    error("row-oriented solvers are not supported by solve_nested().");
+
+  std::vector<double> y_level;
+  int iter = -1;
+  for (int l=0; l < n_levels; l++) {
+    int n = meshes[l]->get_n_dof();
+    std::vector<double> y_new(n, 0.);
+    if (l > 0) 
+      prolongate_solution(meshes[l-1], &y_level[0], meshes[l], &y_new[0]);
+    y_level.swap(y_new);
+
+    dp->set_mesh(meshes[l]);
+    iter = solve_newton(dp, solver, &y_level[0], tol, max_iter);
+    if (iters != NULL) iters[l] = iter;
+    if (iter < 0) break;
+  }
+
+  if (iter >= 0) 
+    memcpy(y, &y_level[0], meshes[n_levels-1]->get_n_dof()*sizeof(double));
+  return iter;
+}
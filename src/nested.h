@@ -0,0 +1,44 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_NESTED_H
+#define __HERMES1D_NESTED_H
+
+#include "common.h"
+#include "matrix.h"
+#include "solver.h"
+#include "discrete.h"
+#include "transfer.h"
+
+/// Newton's method for the stationary problem dp on its current mesh,
+/// starting from y (length n_dof), which returns the solution. The
+/// Jacobi matrix has the element sparsity pattern (build_element_pattern())
+/// and is analyzed once. 'tol' applies to the L2 norm of the residual.
+/// Returns the number of iterations, or -1 if the method did not converge.
+/// The wall clock times of the assembling and of the linear solves
+/// (analysis, factorization, solution) are added to *assembly_time and
+/// *solve_time, if not NULL.
+int solve_newton(DiscreteProblem *dp, Solver *solver, double *y, 
+                 double tol=1e-8, int max_iter=50,
+                 double *assembly_time=NULL, double *solve_time=NULL);
+
+/// Nested iteration (mesh sequencing) for stationary problems. Newton's
+/// method is run on the meshes meshes[0], ..., meshes[n_levels-1], from
+/// the coarsest to the finest, each level nested in the previous one (in
+/// h and/or p, see prolongate_solution()). The coarsest level starts from
+/// zero, every other level from the solution of the previous level, so
+/// the finest levels only need the last few (quadratically convergent)
+/// iterations.
+///
+/// The forms of 'dp' are used on all levels (dp is left on the finest
+/// mesh). y (length meshes[n_levels-1]->get_n_dof()) returns the solution
+/// on the finest mesh, iters[l] (if not NULL) the number of Newton
+/// iterations on the level l. 'tol' applies to the L2 norm of the
+/// residual. Returns the number of iterations on the finest level, or -1
+/// if Newton's method did not converge on some level.
+int solve_nested(DiscreteProblem *dp, Mesh **meshes, int n_levels, Solver *solver,
+                 double *y, int *iters=NULL, double tol=1e-8, int max_iter=50);
+
+#endif
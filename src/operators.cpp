@@ -0,0 +1,69 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include "operators.h"
+
+RefMatrices::RefMatrices()
+{
+  // Legendre expansions of the Lobatto shape functions and of their
+  // derivatives: l_0 = (P_0 - P_1)/2, l_1 = (P_0 + P_1)/2,
+  // l_k = (P_k - P_{k-2})/sqrt(2(2k-1)), l_k' = sqrt((2k-1)/2) P_{k-1}
+  double fn[MAX_LOBATTO_NUM][MAX_LOBATTO_NUM];
+  double der[MAX_LOBATTO_NUM][MAX_LOBATTO_NUM];
+  for (int k=0; k<MAX_LOBATTO_NUM; k++)
+    for (int a=0; a<MAX_LOBATTO_NUM; a++) fn[k][a] = der[k][a] = 0;
+  fn[0][0] = 0.5;  fn[0][1] = -0.5;  der[0][0] = -0.5;
+  fn[1][0] = 0.5;  fn[1][1] = 0.5;   der[1][0] = 0.5;
+  for (int k=2; k<MAX_LOBATTO_NUM; k++) {
+    double s = sqrt(2.*(2*k - 1));
+    fn[k][k] = 1./s;
+    fn[k][k-2] = -1./s;
+    der[k][k-1] = sqrt((2*k - 1)/2.);
+  }
+
+  // orthogonality of Legendre polynomials: \int P_a P_b = 2/(2a+1) \delta_{ab}
+  for (int i=0; i<MAX_LOBATTO_NUM; i++) {
+    for (int j=0; j<MAX_LOBATTO_NUM; j++) {
+      stiffness[i][j] = mass[i][j] = advection[i][j] = 0;
+      for (int a=0; a<MAX_LOBATTO_NUM; a++) {
+        double norm = 2./(2*a + 1);
+        stiffness[i][j] += der[i][a]*der[j][a]*norm;
+        mass[i][j] += fn[i][a]*fn[j][a]*norm;
+        advection[i][j] += fn[i][a]*der[j][a]*norm;
+      }
+    }
+  }
+
+  for (int i=0; i<MAX_LOBATTO_NUM; i++) {
+    for (int j=0; j<MAX_LOBATTO_NUM; j++) mass_lumped[i][j] = 0;
+    if (i < 2) mass_lumped[i][i] = mass[i][0] + mass[i][1];
+  }
+}
+
+double (*RefMatrices::get(int op))[MAX_LOBATTO_NUM]
+{
+  switch (op) {
+    case OP_DIFFUSION: return this->stiffness;
+    case OP_MASS:      return this->mass;
+    case OP_ADVECTION: return this->advection;
+    case OP_MASS_LUMPED: return this->mass_lumped;
+  }
+  error("unknown operator in RefMatrices::get().");
+  return NULL;
+}
+
+double RefMatrices::get_scale(int op, double jac)
+{
+  switch (op) {
+    case OP_DIFFUSION: return 1./jac;
+    case OP_MASS:      return jac;
+    case OP_ADVECTION: return 1.;
+    case OP_MASS_LUMPED: return jac;
+  }
+  error("unknown operator in RefMatrices::get_scale().");
+  return 0;
+}
+
+RefMatrices g_ref_matrices;
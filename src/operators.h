@@ -0,0 +1,55 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_OPERATORS_H
+#define __HERMES1D_OPERATORS_H
+
+#include "common.h"
+#include "lobatto.h"
+
+// built-in linear operators (u...basis function, v...test function,
+// c...constant or elementwise constant coefficient)
+#define OP_DIFFUSION 0      // \int c u' v'
+#define OP_MASS 1           // \int c u v
+#define OP_ADVECTION 2      // \int c u' v
+#define OP_REACTION OP_MASS // \int c u v
+#define OP_MASS_LUMPED 3    // diagonal (lumped) version of OP_MASS, p = 1 only
+
+/// Element matrices of the Lobatto shape functions on the reference
+/// interval (-1, 1). They are calculated in closed form from the Legendre
+/// expansions of the shape functions, so no quadrature is involved.
+/// Index [i][j] means test function 'i' and basis function 'j'.
+///
+/// On a physical element of length h (jacobian h/2) the element matrices
+/// are stiffness/jac, mass*jac and advection (independent of h).
+class RefMatrices
+{
+public:
+  RefMatrices();
+
+  double stiffness[MAX_LOBATTO_NUM][MAX_LOBATTO_NUM]; // \int l_j' l_i'
+  double mass[MAX_LOBATTO_NUM][MAX_LOBATTO_NUM];      // \int l_j l_i
+  double advection[MAX_LOBATTO_NUM][MAX_LOBATTO_NUM]; // \int l_j' l_i
+  // Lumped mass matrix of the linear elements: the vertex functions get
+  // the row sums of the vertex-vertex block (trapezoidal rule). It is
+  // diagonal and positive definite, so the global lumped mass matrix can
+  // be inverted without a linear solve. The lumping is only defined for
+  // p = 1 and is first order accurate in time-dependent problems (O(h^2)
+  // in L2). In the hierarchic basis there is no diagonal lumping for
+  // p > 1: dropping the vertex-bubble coupling decouples the bubbles and
+  // gives back the accuracy of p = 1, so DiscreteProblem rejects
+  // OP_MASS_LUMPED on elements of higher degree. The bubble rows are zero.
+  double mass_lumped[MAX_LOBATTO_NUM][MAX_LOBATTO_NUM];
+
+  // reference matrix of the operator 'op' (one of OP_*)
+  double (*get(int op))[MAX_LOBATTO_NUM];
+  // factor transforming the reference matrix of 'op' to an element
+  // with the jacobian 'jac'
+  double get_scale(int op, double jac);
+};
+
+extern RefMatrices g_ref_matrices;
+
+#endif
@@ -3,27 +3,150 @@
 // file for the exact terms).
 // Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
 
+#include <math.h>
+#include <stdlib.h>
+
 #include "quad_std.h"
 
 // transformation of quadrature to physical element
-void create_element_quadrature(double a, double b, 
-                        int order, double *pts, double *weights, int *num) {
-  double2 *ref_tab = g_quad_1d_std.get_points(order);
-  *num = g_quad_1d_std.get_num_points(order);
+void create_element_quadrature(double a, double b,
+                        int order, double *pts, double *weights, int *num,
+                        Quad1D *quad) {
+  double *ref_pts = quad->get_points(order);
+  double *ref_weights = quad->get_weights(order);
+  *num = quad->get_num_points(order);
   for (int i=0;i<*num;i++) {
     //change points and weights to interval (a, b)
-    pts[i] = (b-a)/2.*ref_tab[i][0]+(b+a)/2.; 
-    weights[i] = ref_tab[i][1]*(b-a)/2.;
+    pts[i] = (b-a)/2.*ref_pts[i]+(b+a)/2.;
+    weights[i] = ref_weights[i]*(b-a)/2.;
   }
 };
 
-Quad1DStd::Quad1DStd()
+// Legendre polynomials P_n(x) and P_{n-1}(x) by the three-term recurrence
+static void legendre_pair(int n, double x, double *p_n, double *p_nm1)
+{
+  double p0 = 1, p1 = x;
+  if (n == 0) { *p_n = 1; *p_nm1 = 0; return; }
+  for (int k=2; k<=n; k++) {
+    double p_k = ((2*k - 1)*x*p1 - (k - 1)*p0)/k;
+    p0 = p1;
+    p1 = p_k;
+  }
+  *p_n = p1;
+  *p_nm1 = p0;
+}
+
+static double *aligned_alloc_doubles(int n)
+{
+  void *ptr = NULL;
+  if (posix_memalign(&ptr, QUAD_ALIGNMENT, n*sizeof(double)) != 0)
+    error("out of memory in Quad1D.");
+  return (double*) ptr;
+}
+
+Quad1D::Quad1D()
 {
-  tables = std_tables_1d;
-  np = std_np_1d;
   ref_vert[0] = -1.0;
   ref_vert[1] = 1.0;
-  max_order = 99;
+  max_order = 0;
+  for (int n=0; n<=MAX_QUAD_PTS_NUM; n++) pts_tab[n] = wts_tab[n] = NULL;
+  pthread_mutex_init(&lock, NULL);
+}
+
+Quad1D::~Quad1D()
+{
+  for (int n=0; n<=MAX_QUAD_PTS_NUM; n++) {
+    free(pts_tab[n]);
+    free(wts_tab[n]);
+  }
+  pthread_mutex_destroy(&lock);
+}
+
+void Quad1D::init_tables(int n)
+{
+  for (int i=calc_num_points(0); i<=n; i++) generate(i);
+}
+
+void Quad1D::generate(int n)
+{
+  if (n < 1 || n > MAX_QUAD_PTS_NUM)
+    error("number of quadrature points too high in Quad1D.");
+  pthread_mutex_lock(&lock);
+  if (pts_tab[n] == NULL) {
+    double *pts = aligned_alloc_doubles(n);
+    double *weights = aligned_alloc_doubles(n);
+    calc_points(n, pts, weights);
+    wts_tab[n] = weights;
+    pts_tab[n] = pts;
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+// Gauss-Legendre points: the roots of P_n, weights 2/((1-x^2)P_n'(x)^2)
+void Quad1DStd::calc_points(int n, double *pts, double *weights)
+{
+  for (int i=0; i<(n + 1)/2; i++) {
+    // asymptotic approximation of the i-th largest root as the initial guess
+    double x = cos(M_PI*(i + 0.75)/(n + 0.5));
+    double p_n, p_nm1, dp;
+    for (int it=0; it<100; it++) {
+      legendre_pair(n, x, &p_n, &p_nm1);
+      dp = n*(x*p_n - p_nm1)/(x*x - 1);
+      double dx = p_n/dp;
+      x -= dx;
+      if (fabs(dx) < 1e-15) break;
+    }
+    if (2*i + 1 == n) x = 0;
+    legendre_pair(n, x, &p_n, &p_nm1);
+    dp = n*(x*p_n - p_nm1)/(x*x - 1);
+    double w = 2./((1 - x*x)*dp*dp);
+    pts[i] = -x;
+    pts[n-1-i] = x;
+    weights[i] = weights[n-1-i] = w;
+  }
+}
+
+Quad1DStd::Quad1DStd()
+{
+  max_order = 2*MAX_QUAD_PTS_NUM - 1;
+  init_tables(MAX_PTS_NUM);
+}
+
+// Gauss-Lobatto points: the end points and the roots of P_{n-1}',
+// weights 2/(n(n-1)P_{n-1}(x)^2)
+void Quad1DLobatto::calc_points(int n, double *pts, double *weights)
+{
+  if (n < 2) error("Gauss-Lobatto quadrature needs at least two points.");
+  int N = n - 1;
+  for (int i=0; i<(n + 1)/2; i++) {
+    // Chebyshev-Gauss-Lobatto points as the initial guess
+    double x = cos(M_PI*i/N);
+    double p_n, p_nm1;
+    if (i > 0) {
+      for (int it=0; it<100; it++) {
+        legendre_pair(N, x, &p_n, &p_nm1);
+        // Newton's step for P_N'(x) = 0 using P_N'' = (2xP_N' - N(N+1)P_N)/(1-x^2)
+        double dp = N*(x*p_n - p_nm1)/(x*x - 1);
+        double ddp = (2*x*dp - N*(N + 1)*p_n)/(1 - x*x);
+        double dx = dp/ddp;
+        x -= dx;
+        if (fabs(dx) < 1e-15) break;
+      }
+    }
+    if (2*i + 1 == n) x = 0;
+    legendre_pair(N, x, &p_n, &p_nm1);
+    double w = 2./(N*n*p_n*p_n);
+    pts[i] = -x;
+    pts[n-1-i] = x;
+    weights[i] = weights[n-1-i] = w;
+  }
+}
+
+Quad1DLobatto::Quad1DLobatto()
+{
+  max_order = 2*MAX_QUAD_PTS_NUM - 3;
+  init_tables(MAX_PTS_NUM);
 }
 
 Quad1DStd g_quad_1d_std;
+Quad1DLobatto g_quad_1d_lobatto;
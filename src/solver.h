@@ -6,13 +6,17 @@
 #ifndef __HERMES1D_SOLVER_H
 #define __HERMES1D_SOLVER_H
 
+#include <vector>
+
+#include "common.h"
+
 /// \brief Abstract interface to sparse linear solvers.
 ///
 ///  Solver is an abstract class defining the interface to all linear solvers
 ///  used by Hermes1D. A concrete derived class (UmfpackSolver, PardisoSolver...)
 ///  is instantiated by the user and passed to the LinSystem class to solve the
-///  discrete system. The user never directly calls any of the methods of this
-///  class.
+///  discrete system, or to a driver such as TimeStepper (timestep.h), which
+///  calls the methods below to reuse factorizations between solves.
 ///
 ///  The linear solver can be direct or iterative, although the analyze() and 
 ///  factorize() methods are clearly designed for direct solvers. These
@@ -26,8 +30,9 @@
 ///
 class Solver
 {
-protected:
-  
+public:
+  virtual ~Solver() {}
+
   /// Must return true if the solvers expects compressed row (CSR) format.
   /// Otherwise LinSystem assumes the compressed column (CSC) format.
   virtual bool is_row_oriented() = 0;
@@ -51,14 +56,14 @@ protected:
   /// the results for reuse in the execution context. If the solver does not
   /// support the reuse of structural analysis, this method does not have to be 
   /// implemented.  \return true on success, false otherwise.
-  virtual bool analyze(void* ctx, int n, int* Ap, int* Ai, scalar* Ax, bool sym) {}
+  virtual bool analyze(void* ctx, int n, int* Ap, int* Ai, scalar* Ax, bool sym) { return true; }
   
   /// Called by LinSystem after the stiffness matrix has been assembled. 
   /// Direct solvers should implement this function and store the result 
   /// of the factorization in the execution context, so that it can be used
   /// many times by solve() for different right hand sides.
   /// \return true on success, false otherwise.
-  virtual bool factorize(void* ctx, int n, int* Ap, int* Ai, scalar* Ax, bool sym) {}
+  virtual bool factorize(void* ctx, int n, int* Ap, int* Ai, scalar* Ax, bool sym) { return true; }
 
   /// Direct solvers will want to use the matrix factorization stored in "ctx".
   /// Iterative solvers will probably solve the system from scratch in this call,
@@ -79,5 +84,47 @@ protected:
 
 };
 
+/// Owns 'num' contexts of a solver and frees them (free_data() and
+/// free_context()) when it goes out of scope, also when an exception
+/// is thrown by the code using them.
+class SolverContexts
+{
+public:
+  SolverContexts(Solver *solver, int num=1, bool sym=false) 
+  {
+    this->solver = solver;
+    try {
+      for (int i=0; i < num; i++) this->ctx.push_back(solver->new_context(sym));
+    }
+    catch (...) {
+      this->free_all();
+      throw;
+    }
+  }
+  ~SolverContexts() 
+  {
+    this->free_all();
+  }
+  void *get(int i=0) 
+  {
+    return this->ctx[i];
+  }
+
+private:
+  Solver *solver;
+  std::vector<void *> ctx;
+
+  void free_all() 
+  {
+    for (int i=0; i < this->ctx.size(); i++) {
+      this->solver->free_data(this->ctx[i]);
+      this->solver->free_context(this->ctx[i]);
+    }
+  }
+  // not copyable
+  SolverContexts(const SolverContexts &);
+  SolverContexts &operator=(const SolverContexts &);
+};
+
 
 #endif
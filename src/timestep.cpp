@@ -0,0 +1,460 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include "timestep.h"
+
+void csc_mult_add(CSRMatrix *mat, double scale, double *x, double *res)
+{
+  int n = mat->get_size();
+  int *IA = mat->get_IA();
+  int *JA = mat->get_JA();
+  double *A = mat->get_A();
+  // column 'j' of the matrix is stored in the row 'j' of 'mat'
+  for (int j=0; j < n; j++) {
+    double xj = scale*x[j];
+    if (xj == 0) continue;
+    for (int k=IA[j]; k < IA[j+1]; k++) res[JA[k]] += A[k]*xj;
+  }
+}
+
+TimeStepper::TimeStepper(DiscreteProblem *dp_mass, DiscreteProblem *dp, 
+                         Solver *solver, int method)
+{
+  if (dp_mass->get_mesh() != dp->get_mesh()) 
+    error("the mass and spatial problems must share the mesh in TimeStepper.");
+  if (method < TS_IMPLICIT_EULER || method > TS_CRANK_NICOLSON) 
+    error("unknown time integration method in TimeStepper.");
+  if (solver->is_row_oriented()) 
+    error("row-oriented solvers are not supported by TimeStepper.");
+  this->dp_mass = dp_mass;
+  this->dp = dp;
+  this->solver = solver;
+  this->ctx = solver->new_context(false);
+  this->method = method;
+  this->n_dof = dp->get_mesh()->get_n_dof();
+  this->linear = false;
+  this->newton_tol = 1e-8;
+  this->newton_max_iter = 50;
+  this->time = 0;
+  this->dt_prev = 0;
+  this->n_steps = 0;
+
+  int n = this->n_dof;
+  this->y = new double[n];
+  this->y_prev = new double[n];
+  this->y_prev2 = new double[n];
+  this->f_prev = new double[n];
+  this->res = new double[n];
+  this->vec = new double[n];
+  this->tmp = new double[n];
+  for (int i=0; i < n; i++) this->y[i] = this->y_prev[i] = this->y_prev2[i] = 0;
+  this->f_prev_valid = false;
+
+  this->mass = NULL;
+  this->mat = NULL;
+  this->mat_scale_m = this->mat_scale_j = 0;
+  this->n_factorizations = 0;
+  this->assemble_mass();
+}
+
+TimeStepper::~TimeStepper()
+{
+  this->solver->free_data(this->ctx);
+  this->solver->free_context(this->ctx);
+  delete this->mass;
+  delete this->mat;
+  delete [] this->y;
+  delete [] this->y_prev;
+  delete [] this->y_prev2;
+  delete [] this->f_prev;
+  delete [] this->res;
+  delete [] this->vec;
+  delete [] this->tmp;
+}
+
+void TimeStepper::assemble_mass()
+{
+  // the mass forms are linear, the solution vector is not used
+  for (int i=0; i < this->n_dof; i++) this->tmp[i] = 0;
+  CooMatrix coo(this->n_dof);
+  this->dp_mass->assemble_matrix(&coo, this->tmp);
+  this->mass = new CSRMatrix(&coo);
+}
+
+void TimeStepper::set_initial_condition(double *y0, double t0)
+{
+  for (int i=0; i < this->n_dof; i++) this->y[i] = this->y_prev[i] = y0[i];
+  this->time = t0;
+  this->n_steps = 0;
+  this->f_prev_valid = false;
+}
+
+void TimeStepper::factorize(double scale_m, double scale_j, double *y)
+{
+  int n = this->n_dof;
+  CooMatrix coo(n);
+  // scale_m*M
+  int *IA = this->mass->get_IA();
+  int *JA = this->mass->get_JA();
+  double *A = this->mass->get_A();
+  for (int i=0; i < n; i++)
+    for (int k=IA[i]; k < IA[i+1]; k++) coo.add(i, JA[k], scale_m*A[k]);
+  // scale_j*J(y)
+  ScaledMatrix jac(&coo, scale_j);
+  this->dp->assemble_matrix(&jac, y);
+  CSRMatrix *new_mat = new CSRMatrix(&coo);
+
+  // the symbolic analysis is reused if the sparsity pattern did not change
+  bool same_pattern = this->mat != NULL && this->mat->get_nnz() == new_mat->get_nnz();
+  if (same_pattern) {
+    same_pattern = memcmp(this->mat->get_IA(), new_mat->get_IA(), (n+1)*sizeof(int)) == 0 &&
+      memcmp(this->mat->get_JA(), new_mat->get_JA(), new_mat->get_nnz()*sizeof(int)) == 0;
+  }
+  if (!same_pattern) {
+    if (!this->solver->analyze(this->ctx, n, new_mat->get_IA(), new_mat->get_JA(),
+                               new_mat->get_A(), false))
+      error("matrix analysis failed in TimeStepper.");
+  }
+  if (!this->solver->factorize(this->ctx, n, new_mat->get_IA(), new_mat->get_JA(),
+                               new_mat->get_A(), false))
+    error("matrix factorization failed in TimeStepper.");
+  delete this->mat;
+  this->mat = new_mat;
+  this->mat_scale_m = scale_m;
+  this->mat_scale_j = scale_j;
+  this->n_factorizations++;
+}
+
+int TimeStepper::step(double dt)
+{
+  int n = this->n_dof;
+  if (dt <= 0) error("time step must be positive in TimeStepper::step().");
+
+  // method coefficients
+  double a0 = 1, a1 = -1, a2 = 0, theta = 1;
+  if (this->method == TS_BDF2 && this->n_steps > 0) {
+    double w = dt/this->dt_prev;
+    a0 = (1 + 2*w)/(1 + w);
+    a1 = -(1 + w);
+    a2 = w*w/(1 + w);
+  }
+  if (this->method == TS_CRANK_NICOLSON) theta = 0.5;
+
+  // F(Y_n)
+  if (!this->f_prev_valid) {
+    this->dp->assemble_vector(this->f_prev, this->y_prev);
+    this->f_prev_valid = true;
+  }
+
+  for (int i=0; i < n; i++) this->y[i] = this->y_prev[i];
+  int it = 0;
+  while (1) {
+    // residual of the time discrete problem
+    if (it == 0) {
+      for (int i=0; i < n; i++) this->res[i] = this->f_prev[i];
+    }
+    else {
+      this->dp->assemble_vector(this->res, this->y);
+      for (int i=0; i < n; i++) 
+        this->res[i] = theta*this->res[i] + (1 - theta)*this->f_prev[i];
+    }
+    for (int i=0; i < n; i++) 
+      this->tmp[i] = a0*this->y[i] + a1*this->y_prev[i] + a2*this->y_prev2[i];
+    csc_mult_add(this->mass, 1./dt, this->tmp, this->res);
+
+    if (!this->linear) {
+      double res_norm = 0;
+      for (int i=0; i < n; i++) res_norm += this->res[i]*this->res[i];
+      res_norm = sqrt(res_norm);
+      if (res_norm < this->newton_tol) break;
+      if (it >= this->newton_max_iter) 
+        error("Newton's method did not converge in TimeStepper::step().");
+    }
+
+    // the matrix of a linear problem is reused while dt is fixed
+    if (!this->linear || this->mat == NULL || this->mat_scale_m != a0/dt || 
+        this->mat_scale_j != theta)
+      this->factorize(a0/dt, theta, this->y);
+
+    for (int i=0; i < n; i++) this->res[i] *= -1;
+    if (!this->solver->solve(this->ctx, n, this->mat->get_IA(), this->mat->get_JA(),
+                             this->mat->get_A(), false, this->res, this->vec))
+      error("linear solve failed in TimeStepper::step().");
+    for (int i=0; i < n; i++) this->y[i] += this->vec[i];
+    it++;
+
+    // one Newton step is exact for a linear problem
+    if (this->linear) break;
+  }
+
+  // F(Y_{n+1}) is assembled at the beginning of the next step
+  this->f_prev_valid = false;
+
+  double *t = this->y_prev2;
+  this->y_prev2 = this->y_prev;
+  this->y_prev = t;
+  for (int i=0; i < n; i++) this->y_prev[i] = this->y[i];
+  this->time += dt;
+  this->dt_prev = dt;
+  this->n_steps++;
+
+  return it;
+}
+
+// diagonal coefficient of Alexander's SDIRK2
+static const double SDIRK_GAMMA = 1 - sqrt(2.)/2;
+
+AdaptiveTimeStepper::AdaptiveTimeStepper(DiscreteProblem *dp_mass, DiscreteProblem *dp,
+                                         Solver *solver)
+  : TimeStepper(dp_mass, dp, solver, TS_IMPLICIT_EULER)
+{
+  this->rtol = 1e-4;
+  this->atol = 1e-6;
+  this->dt = 1e-3;
+  this->dt_min = 1e-12;
+  this->dt_max = 1e100;
+  this->n_accepted = this->n_rejected = 0;
+  this->jac_fresh = false;
+  this->stage1 = new double[this->n_dof];
+  this->stage2 = new double[this->n_dof];
+  this->stage_rhs = new double[this->n_dof];
+}
+
+AdaptiveTimeStepper::~AdaptiveTimeStepper()
+{
+  delete [] this->stage1;
+  delete [] this->stage2;
+  delete [] this->stage_rhs;
+}
+
+double AdaptiveTimeStepper::error_norm(double *v)
+{
+  int n = this->n_dof;
+  if (n == 0) return 0;
+  double sum = 0;
+  for (int i=0; i < n; i++) {
+    double scale = this->atol + this->rtol*fmax(fabs(this->y_prev[i]), fabs(this->y[i]));
+    sum += (v[i]/scale)*(v[i]/scale);
+  }
+  return sqrt(sum/n);
+}
+
+bool AdaptiveTimeStepper::solve_stage(double dt, double *Y, double *rhs)
+{
+  int n = this->n_dof;
+  double scale_j = dt*SDIRK_GAMMA;
+  // a linear problem needs the exact matrix; a nonlinear one keeps the
+  // (possibly old) Jacobian as long as dt is the same
+  if (this->mat == NULL || this->mat_scale_j != scale_j) {
+    this->factorize(1, scale_j, Y);
+    this->jac_fresh = true;
+  }
+
+  double prev_norm = 0;
+  for (int it=0; it < this->newton_max_iter; it++) {
+    // residual M (Y - Y_n) + dt gamma F(Y) + rhs
+    this->dp->assemble_vector(this->res, Y);
+    for (int i=0; i < n; i++) {
+      this->res[i] = -(scale_j*this->res[i] + rhs[i]);
+      this->tmp[i] = Y[i] - this->y_prev[i];
+    }
+    csc_mult_add(this->mass, -1, this->tmp, this->res);
+    if (!this->solver->solve(this->ctx, n, this->mat->get_IA(), this->mat->get_JA(),
+                             this->mat->get_A(), false, this->res, this->vec))
+      error("linear solve failed in AdaptiveTimeStepper.");
+    for (int i=0; i < n; i++) Y[i] += this->vec[i];
+    if (this->linear) return true;
+
+    // the Newton increment must be well below the error tolerance
+    double norm = this->error_norm(this->vec);
+    if (norm < 1e-2) return true;
+    if (it > 0 && norm > 0.9*prev_norm) return false;
+    prev_norm = norm;
+  }
+  return false;
+}
+
+double AdaptiveTimeStepper::step_adaptive(double t_end)
+{
+  int n = this->n_dof;
+  double g = SDIRK_GAMMA;
+  this->jac_fresh = false;
+  while (1) {
+    double dt = fmin(this->dt, this->dt_max);
+    bool last = false;
+    if (this->time + dt >= t_end) {
+      dt = t_end - this->time;
+      last = true;
+    }
+    if (dt < this->dt_min && !last) error("time step too small in AdaptiveTimeStepper.");
+
+    // stage 1: M (Y1 - Y_n) + dt gamma F(Y1) = 0
+    for (int i=0; i < n; i++) {
+      this->stage1[i] = this->y_prev[i];
+      this->stage_rhs[i] = 0;
+    }
+    bool ok = this->solve_stage(dt, this->stage1, this->stage_rhs);
+
+    // stage 2: M (Y2 - Y_n) + dt gamma F(Y2) + dt (1-gamma) F(Y1) = 0,
+    // where dt F(Y1) = -M (Y1 - Y_n)/gamma by stage 1
+    if (ok) {
+      for (int i=0; i < n; i++) {
+        this->tmp[i] = this->stage1[i] - this->y_prev[i];
+        this->stage_rhs[i] = 0;
+        this->stage2[i] = this->stage1[i];
+      }
+      csc_mult_add(this->mass, -(1 - g)/g, this->tmp, this->stage_rhs);
+      ok = this->solve_stage(dt, this->stage2, this->stage_rhs);
+    }
+
+    if (!ok) {
+      // retry with a fresh Jacobian first, then with a smaller step
+      if (!this->jac_fresh) {
+        this->factorize(1, dt*g, this->y_prev);
+        this->jac_fresh = true;
+      }
+      else {
+        this->dt = dt/4;
+        this->n_rejected++;
+        // the matrix of the smaller step is factorized by solve_stage()
+      }
+      continue;
+    }
+
+    // the difference to the embedded solution (M (Yhat - Y_n) = -dt F(Y1))
+    // is M^{-1} times M (Y2 - Y_n) + dt F(Y1) = M ((Y2 - Y_n) - (Y1 - Y_n)/gamma);
+    // instead of M^{-1}, the estimate is filtered by (M + dt gamma J)^{-1}
+    for (int i=0; i < n; i++) {
+      this->tmp[i] = (this->stage2[i] - this->y_prev[i]) - 
+        (this->stage1[i] - this->y_prev[i])/g;
+      this->res[i] = 0;
+      this->y[i] = this->stage2[i];
+    }
+    csc_mult_add(this->mass, 1, this->tmp, this->res);
+    if (!this->solver->solve(this->ctx, n, this->mat->get_IA(), this->mat->get_JA(),
+                             this->mat->get_A(), false, this->res, this->vec))
+      error("linear solve failed in AdaptiveTimeStepper.");
+    double err = this->error_norm(this->vec);
+
+    // new step size (second order method: exponent 1/2)
+    double fac = (err > 0) ? 0.9/sqrt(err) : 5;
+    if (fac > 5) fac = 5;
+    if (fac < 0.2) fac = 0.2;
+    if (err <= 1) {
+      // keep dt (and the factorization) for small increases
+      if (fac >= 1 && fac < 1.2) fac = 1;
+      if (!last || dt*fac < this->dt) this->dt = dt*fac;
+      for (int i=0; i < n; i++) this->y_prev[i] = this->y[i];
+      this->time = last ? t_end : this->time + dt;
+      this->n_accepted++;
+      this->n_steps++;
+      return dt;
+    }
+    for (int i=0; i < n; i++) this->y[i] = this->y_prev[i];
+    this->dt = dt*fac;
+    this->n_rejected++;
+  }
+}
+
+void AdaptiveTimeStepper::integrate(double t_end)
+{
+  while (this->time < t_end) this->step_adaptive(t_end);
+}
+
+ExplicitTimeStepper::ExplicitTimeStepper(DiscreteProblem *dp_mass, DiscreteProblem *dp,
+                                         int method, int n_threads)
+{
+  if (dp_mass->get_mesh() != dp->get_mesh()) 
+    error("the mass and spatial problems must share the mesh in ExplicitTimeStepper.");
+  if (method < TS_SSP_RK2 || method > TS_RK4) 
+    error("unknown explicit time integration method in ExplicitTimeStepper.");
+  this->dp = dp;
+  this->method = method;
+  this->n_threads = n_threads;
+  int n = this->n_dof = dp->get_mesh()->get_n_dof();
+  this->time = 0;
+  this->y = new double[n];
+  this->inv_mass = new double[n];
+  this->stage = new double[n];
+  this->rate = new double[n];
+  this->acc = new double[n];
+  for (int i=0; i < n; i++) this->y[i] = 0;
+
+  // the (lumped) mass forms are linear, the solution vector is not used
+  DiagonalMatrix mass(n);
+  dp_mass->assemble_matrix(&mass, this->y);
+  double *diag = mass.get_diag();
+  for (int i=0; i < n; i++) {
+    if (diag[i] <= 0) error("mass matrix not positive in ExplicitTimeStepper.");
+    this->inv_mass[i] = 1./diag[i];
+  }
+}
+
+ExplicitTimeStepper::~ExplicitTimeStepper()
+{
+  delete [] this->y;
+  delete [] this->inv_mass;
+  delete [] this->stage;
+  delete [] this->rate;
+  delete [] this->acc;
+}
+
+void ExplicitTimeStepper::set_initial_condition(double *y0, double t0)
+{
+  for (int i=0; i < this->n_dof; i++) this->y[i] = y0[i];
+  this->time = t0;
+}
+
+void ExplicitTimeStepper::eval_rate(double *v)
+{
+  this->dp->assemble_vector_threaded(this->rate, v, this->n_threads);
+  for (int i=0; i < this->n_dof; i++) this->rate[i] *= -this->inv_mass[i];
+}
+
+void ExplicitTimeStepper::step(double dt)
+{
+  int n = this->n_dof;
+  double *y = this->y, *s = this->stage, *r = this->rate, *acc = this->acc;
+  switch (this->method) {
+    case TS_SSP_RK2:
+      // y1 = y + dt L(y), y_new = (y + y1 + dt L(y1))/2
+      this->eval_rate(y);
+      for (int i=0; i < n; i++) s[i] = y[i] + dt*r[i];
+      this->eval_rate(s);
+      for (int i=0; i < n; i++) y[i] = 0.5*(y[i] + s[i] + dt*r[i]);
+      break;
+    case TS_SSP_RK3:
+      // y1 = y + dt L(y), y2 = 3/4 y + 1/4 (y1 + dt L(y1)),
+      // y_new = 1/3 y + 2/3 (y2 + dt L(y2))
+      this->eval_rate(y);
+      for (int i=0; i < n; i++) s[i] = y[i] + dt*r[i];
+      this->eval_rate(s);
+      for (int i=0; i < n; i++) s[i] = 0.75*y[i] + 0.25*(s[i] + dt*r[i]);
+      this->eval_rate(s);
+      for (int i=0; i < n; i++) y[i] = (y[i] + 2*(s[i] + dt*r[i]))/3.;
+      break;
+    case TS_RK4:
+      // acc accumulates k1 + 2 k2 + 2 k3 + k4
+      this->eval_rate(y);
+      for (int i=0; i < n; i++) {
+        acc[i] = r[i];
+        s[i] = y[i] + 0.5*dt*r[i];
+      }
+      this->eval_rate(s);
+      for (int i=0; i < n; i++) {
+        acc[i] += 2*r[i];
+        s[i] = y[i] + 0.5*dt*r[i];
+      }
+      this->eval_rate(s);
+      for (int i=0; i < n; i++) {
+        acc[i] += 2*r[i];
+        s[i] = y[i] + dt*r[i];
+      }
+      this->eval_rate(s);
+      for (int i=0; i < n; i++) y[i] += dt/6.*(acc[i] + r[i]);
+      break;
+  }
+  this->time += dt;
+}
@@ -0,0 +1,211 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_TIMESTEP_H
+#define __HERMES1D_TIMESTEP_H
+
+#include "common.h"
+#include "matrix.h"
+#include "solver.h"
+#include "discrete.h"
+
+// time integration methods
+#define TS_IMPLICIT_EULER 0
+#define TS_BDF2 1             // the first step is done by implicit Euler
+#define TS_CRANK_NICOLSON 2
+// explicit methods (ExplicitTimeStepper)
+#define TS_SSP_RK2 3          // optimal two-stage SSP Runge-Kutta (Heun)
+#define TS_SSP_RK3 4          // three-stage SSP Runge-Kutta of Shu and Osher
+#define TS_RK4 5              // classical fourth-order Runge-Kutta
+
+/// Method-of-lines time stepping for the problem M dY/dt + F(Y) = 0.
+///
+/// The mass matrix M is assembled from the matrix forms of 'dp_mass' (for
+/// example dp_mass.add_operator(0, 0, OP_MASS, 1.0)), it must not depend on
+/// the solution. F and its Jacobian J are the residual and the Jacobi
+/// matrix of the spatial forms of 'dp', exactly as in a stationary problem.
+/// Both problems must use the same mesh. Dirichlet values must not change
+/// in time; time-dependent forms can read the current time from a global
+/// variable updated by the caller before each step (get_time() + dt).
+///
+/// BDF2 uses the variable step size formula if dt changes.
+///
+/// Every step solves the nonlinear system
+///   M/dt (a0 Y + a1 Y_n + a2 Y_{n-1}) + theta F(Y) + (1-theta) F(Y_n) = 0
+/// by Newton's method with the matrix a0 M/dt + theta J. For problems
+/// marked linear by set_linear(), the matrix is assembled and factorized
+/// only when dt (or the method coefficients) change, and each step costs
+/// one residual assembly and one back-substitution.
+class TimeStepper {
+public:
+    TimeStepper(DiscreteProblem *dp_mass, DiscreteProblem *dp, Solver *solver,
+                int method=TS_IMPLICIT_EULER);
+    virtual ~TimeStepper();
+
+    // F is affine in Y and J does not depend on Y (one Newton step per
+    // time step, the factorization is reused)
+    void set_linear(bool linear) {
+        this->linear = linear;
+    }
+    void set_newton(double tol, int max_iter) {
+        this->newton_tol = tol;
+        this->newton_max_iter = max_iter;
+    }
+    // copies y0 (length n_dof) as the solution at time t0
+    void set_initial_condition(double *y0, double t0=0);
+    // advances the solution by dt, returns the number of Newton iterations
+    int step(double dt);
+
+    double *get_solution() {
+        return this->y;
+    }
+    double get_time() {
+        return this->time;
+    }
+    int get_n_dof() {
+        return this->n_dof;
+    }
+    // number of matrix factorizations done so far
+    int get_n_factorizations() {
+        return this->n_factorizations;
+    }
+
+protected:
+    DiscreteProblem *dp_mass, *dp;
+    Solver *solver;
+    void *ctx;
+    int method;
+    int n_dof;
+    bool linear;
+    double newton_tol;
+    int newton_max_iter;
+
+    double time;
+    double dt_prev;
+    int n_steps;
+    double *y, *y_prev, *y_prev2; // Y_{n+1} (Newton iterate), Y_n, Y_{n-1}
+    double *f_prev;               // F(Y_n)
+    bool f_prev_valid;
+    double *res, *vec, *tmp;
+
+    CSRMatrix *mass;              // M (compressed columns)
+    CSRMatrix *mat;               // factorized a0 M/dt + theta J
+    double mat_scale_m, mat_scale_j; // coefficients of 'mat'
+    int n_factorizations;
+
+    void assemble_mass();
+    // assembles and factorizes scale_m*M + scale_j*J(y)
+    void factorize(double scale_m, double scale_j, double *y);
+};
+
+/// Adaptive time stepping for M dY/dt + F(Y) = 0 (see TimeStepper) by
+/// the two-stage, L-stable SDIRK method of Alexander (order 2, diagonal
+/// gamma = 1 - sqrt(2)/2). The local error is estimated by the difference
+/// to the embedded first-order solution, filtered through (M + dt gamma J)^{-1}
+/// to stay bounded for stiff components, and measured in the weighted RMS
+/// norm with the tolerances rtol, atol.
+///
+/// Both stages and the error filter use the same matrix M + dt gamma J.
+/// A proposed step size increase below 20% is not taken, so the
+/// factorization is kept over steps of the same size. For nonlinear
+/// problems the stages are solved by the simplified Newton's method with
+/// the Jacobian of an earlier step, and the Jacobian is only updated when
+/// the iteration converges slowly.
+class AdaptiveTimeStepper : public TimeStepper {
+public:
+    AdaptiveTimeStepper(DiscreteProblem *dp_mass, DiscreteProblem *dp, Solver *solver);
+    virtual ~AdaptiveTimeStepper();
+
+    void set_tolerances(double rtol, double atol) {
+        this->rtol = rtol;
+        this->atol = atol;
+    }
+    void set_dt_limits(double dt_min, double dt_max) {
+        this->dt_min = dt_min;
+        this->dt_max = dt_max;
+    }
+    // initial (or next) time step size
+    void set_dt(double dt) {
+        this->dt = dt;
+    }
+    double get_dt() {
+        return this->dt;
+    }
+    // performs one accepted step not going beyond t_end (rejected steps
+    // are repeated with smaller dt), returns the step size used
+    double step_adaptive(double t_end);
+    // integrates up to the time t_end
+    void integrate(double t_end);
+
+    int get_n_accepted() {
+        return this->n_accepted;
+    }
+    int get_n_rejected() {
+        return this->n_rejected;
+    }
+
+private:
+    double rtol, atol;
+    double dt, dt_min, dt_max;
+    int n_accepted, n_rejected;
+    bool jac_fresh;               // the Jacobian was evaluated in this step
+    double *stage1, *stage2, *stage_rhs;
+
+    // weighted RMS norm of v with the weights given by y_prev and y
+    double error_norm(double *v);
+    // solves M (Y - Y_n) + dt gamma F(Y) + rhs = 0 for Y, starting with
+    // the given Y; returns false if Newton's method does not converge
+    bool solve_stage(double dt, double *Y, double *rhs);
+};
+
+/// Explicit Runge-Kutta time stepping for M dY/dt + F(Y) = 0 with a
+/// diagonal mass matrix, i.e. dY/dt = -M^{-1} F(Y). The matrix forms of
+/// 'dp_mass' must assemble to a diagonal matrix, typically
+/// dp_mass.add_operator(0, 0, OP_MASS_LUMPED, 1.0) on linear elements
+/// (the lumped mass is not defined for p > 1); it is assembled once
+/// and inverted entrywise. A stage costs one residual assembly of 'dp'
+/// (DiscreteProblem::assemble_vector_threaded with n_threads threads),
+/// no matrix is assembled or solved. The time step must satisfy the
+/// stability limit of the method, which for diffusion scales like h^2.
+class ExplicitTimeStepper {
+public:
+    ExplicitTimeStepper(DiscreteProblem *dp_mass, DiscreteProblem *dp,
+                        int method=TS_SSP_RK3, int n_threads=1);
+    ~ExplicitTimeStepper();
+
+    // copies y0 (length n_dof) as the solution at time t0
+    void set_initial_condition(double *y0, double t0=0);
+    // advances the solution by dt
+    void step(double dt);
+
+    double *get_solution() {
+        return this->y;
+    }
+    double get_time() {
+        return this->time;
+    }
+    int get_n_dof() {
+        return this->n_dof;
+    }
+
+private:
+    DiscreteProblem *dp;
+    int method;
+    int n_threads;
+    int n_dof;
+    double time;
+    double *y;
+    double *inv_mass;             // inverse of the diagonal mass matrix
+    double *stage, *rate, *acc;
+
+    // rate = -M^{-1} F(v)
+    void eval_rate(double *v);
+};
+
+/// res += scale * A x, where 'mat' stores the matrix by columns (this is
+/// what CSRMatrix(CooMatrix*) gives for matrices assembled by DiscreteProblem)
+void csc_mult_add(CSRMatrix *mat, double scale, double *x, double *res);
+
+#endif
@@ -0,0 +1,313 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <math.h>
+#include <pthread.h>
+#include <string>
+
+#include "transfer.h"
+#include "matrix.h"
+#include "operators.h"
+
+// function to be projected and the target of the projection
+struct ProjectionData {
+  // the function fn or the solution y_src on the mesh src
+  projection_fn fn;
+  void *user_data;
+  Mesh *src;
+  double *y_src;
+  int p_src_max;
+
+  Mesh *mesh;
+  double *y;
+  int norm;
+  // see factorize_bubble_mass()
+  double **mass_chol;
+  double mass_diag[MAX_LOBATTO_NUM];
+};
+
+// values and derivatives of the projected function at x
+static void eval_source(ProjectionData *d, double x, double *val, double *der)
+{
+  if (d->fn != NULL) {
+    d->fn(x, val, der, d->user_data);
+    return;
+  }
+  int m = d->src->find_element(x);
+  Element *e = d->src->get_elems() + m;
+  double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  d->src->calculate_elem_coeffs(m, d->y_src, coeffs);
+  double a = e->v1->x, b = e->v2->x;
+  d->src->element_solution_point((2*x - a - b)/(b - a), e, coeffs, val, der);
+}
+
+static void project_element(ProjectionData *d, int m)
+{
+  int n_eq = d->mesh->get_n_eq();
+  Element *e = d->mesh->get_elems() + m;
+  int p = e->p;
+  double a = e->v1->x, b = e->v2->x;
+  double jac = (b - a)/2;
+  double val[MAX_EQN_NUM], der[MAX_EQN_NUM];
+  double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+
+  // vertex values
+  eval_source(d, a, val, der);
+  for (int c=0; c < n_eq; c++) coeffs[c][0] = val[c];
+  eval_source(d, b, val, der);
+  for (int c=0; c < n_eq; c++) coeffs[c][1] = val[c];
+
+  // bubbles: right-hand sides \int u' l_k' (H1), \int (u - u_lin) l_k (L2)
+  // on the reference element
+  if (p >= 2) {
+    for (int c=0; c < n_eq; c++)
+      for (int k=2; k <= p; k++) coeffs[c][k] = 0;
+    int order = 2*p + 2;
+    if (d->fn == NULL && d->p_src_max + p > order) order = d->p_src_max + p;
+    double *pts = g_quad_1d_std.get_points(order);
+    double *weights = g_quad_1d_std.get_weights(order);
+    int num = g_quad_1d_std.get_num_points(order);
+    for (int i=0; i < num; i++) {
+      eval_source(d, jac*pts[i] + (a + b)/2, val, der);
+      if (d->norm == PROJ_H1) {
+        for (int k=2; k <= p; k++) {
+          double dl = lobatto_der_tab_1d[k](pts[i])*weights[i]*jac;
+          for (int c=0; c < n_eq; c++) coeffs[c][k] += der[c]*dl;
+        }
+      }
+      else {
+        double l0 = lobatto_fn_tab_1d[0](pts[i]), l1 = lobatto_fn_tab_1d[1](pts[i]);
+        for (int c=0; c < n_eq; c++) val[c] -= coeffs[c][0]*l0 + coeffs[c][1]*l1;
+        for (int k=2; k <= p; k++) {
+          double l = lobatto_fn_tab_1d[k](pts[i])*weights[i];
+          for (int c=0; c < n_eq; c++) coeffs[c][k] += val[c]*l;
+        }
+      }
+    }
+    if (d->norm == PROJ_L2)
+      for (int c=0; c < n_eq; c++)
+        cholsl<double>(d->mass_chol, p - 1, d->mass_diag, coeffs[c] + 2, coeffs[c] + 2);
+  }
+
+  // the right vertex is written by the next element (the values agree),
+  // so that the threads write disjoint entries
+  int n_elem = d->mesh->get_n_elems();
+  for (int c=0; c < n_eq; c++)
+    for (int k=0; k <= p; k++) {
+      if (k == 1 && m < n_elem - 1) continue;
+      int pos = e->dof[c][k];
+      if (pos != -1) d->y[pos] = coeffs[c][k];
+    }
+}
+
+struct ProjectionWorker {
+  ProjectionData *d;
+  int first, last;
+};
+
+static void *projection_worker(void *data)
+{
+  ProjectionWorker *w = (ProjectionWorker *) data;
+  for (int m=w->first; m < w->last; m++) project_element(w->d, m);
+  return NULL;
+}
+
+// Cholesky factor of the bubble block of the reference mass matrix (for
+// all bubbles up to MAX_LOBATTO_ORDER; the basis is hierarchic, so the
+// leading (p-1) x (p-1) block is the factor for the degree p)
+static double **factorize_bubble_mass(double *diag)
+{
+  int n_b = MAX_LOBATTO_NUM - 2;
+  double **chol = new_matrix<double>(n_b, n_b);
+  for (int i=0; i < n_b; i++)
+    for (int j=0; j < n_b; j++) chol[i][j] = g_ref_matrices.mass[i+2][j+2];
+  choldc(chol, n_b, diag);
+  return chol;
+}
+
+static void project(ProjectionData *d, int n_threads)
+{
+  int n_elem = d->mesh->get_n_elems();
+  d->mass_chol = NULL;
+  if (d->norm == PROJ_L2) d->mass_chol = factorize_bubble_mass(d->mass_diag);
+  else if (d->norm != PROJ_H1) error("unknown norm in project_function().");
+  for (int m=0; m < n_elem; m++)
+    if (d->mesh->get_elems()[m].p > MAX_LOBATTO_ORDER) 
+      error("element degree too high in project_function().");
+
+  if (n_threads < 1) n_threads = 1;
+  if (n_threads > n_elem) n_threads = n_elem;
+  ProjectionWorker *workers = new ProjectionWorker[n_threads];
+  pthread_t *threads = new pthread_t[n_threads];
+  for (int t=0; t < n_threads; t++) {
+    workers[t].d = d;
+    workers[t].first = (long) n_elem*t/n_threads;
+    workers[t].last = (long) n_elem*(t + 1)/n_threads;
+  }
+  // the calling thread does the parts of the threads that cannot be
+  // created, and it waits for the others before reporting any error
+  int n_started = 0;
+  if (n_threads > 1)
+    while (n_started < n_threads && pthread_create(&threads[n_started], NULL, 
+                                                   projection_worker, workers + n_started) == 0)
+      n_started++;
+  std::string msg;
+  try {
+    for (int t=n_started; t < n_threads; t++) projection_worker(workers + t);
+  }
+  catch (std::runtime_error &e) {
+    msg = e.what();
+  }
+  for (int t=0; t < n_started; t++) pthread_join(threads[t], NULL);
+  delete [] workers;
+  delete [] threads;
+  delete [] (char *) d->mass_chol;
+  if (!msg.empty()) error(msg.c_str());
+}
+
+void project_function(Mesh *mesh, projection_fn fn, void *user_data, double *y, 
+                      int norm, int n_threads)
+{
+  ProjectionData d;
+  d.fn = fn;
+  d.user_data = user_data;
+  d.src = NULL;
+  d.y_src = NULL;
+  d.p_src_max = 0;
+  d.mesh = mesh;
+  d.y = y;
+  d.norm = norm;
+  project(&d, n_threads);
+}
+
+void project_solution(Mesh *src, double *y_src, Mesh *dest, double *y_dest, 
+                      int norm, int n_threads)
+{
+  if (src->get_n_eq() != dest->get_n_eq()) 
+    error("different number of equations in project_solution().");
+  ProjectionData d;
+  d.fn = NULL;
+  d.user_data = NULL;
+  d.src = src;
+  d.y_src = y_src;
+  d.p_src_max = 0;
+  for (int m=0; m < src->get_n_elems(); m++)
+    if (src->get_elems()[m].p > d.p_src_max) d.p_src_max = src->get_elems()[m].p;
+  d.mesh = dest;
+  d.y = y_dest;
+  d.norm = norm;
+  project(&d, n_threads);
+}
+
+void transfer_solution(Mesh *src, double *y_src, Mesh *dest, double *y_dest, int norm)
+{
+  int n_eq = dest->get_n_eq();
+  if (src->get_n_eq() != n_eq) 
+    error("different number of equations in transfer_solution().");
+  if (norm != PROJ_L2 && norm != PROJ_H1) error("unknown norm in transfer_solution().");
+  Element *src_elems = src->get_elems();
+  Element *elems = dest->get_elems();
+  int n_src = src->get_n_elems();
+  int n_elem = dest->get_n_elems();
+  for (int m=0; m < n_elem; m++)
+    if (elems[m].p > MAX_LOBATTO_ORDER) 
+      error("element degree too high in transfer_solution().");
+  double mass_diag[MAX_LOBATTO_NUM];
+  double **mass_chol = (norm == PROJ_L2) ? factorize_bubble_mass(mass_diag) : NULL;
+
+  double src_coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  double coeffs[MAX_EQN_NUM][MAX_COEFFS_NUM];
+  double val[MAX_EQN_NUM], der[MAX_EQN_NUM];
+  // merge pass: j is the first source element overlapping the element m,
+  // the source elements are visited once plus once per shared element
+  int j = 0, j_coeffs = -1;
+  for (int m=0; m < n_elem; m++) {
+    double a = elems[m].v1->x, b = elems[m].v2->x;
+    int p = elems[m].p;
+    double eps = 1e-12*(b - a);
+    while (j < n_src - 1 && src_elems[j].v2->x <= a + eps) j++;
+
+    for (int c=0; c < n_eq; c++)
+      for (int k=0; k <= p; k++) coeffs[c][k] = 0;
+    // overlaps of (a, b) with the source elements j, j+1, ...
+    int k_src = j;
+    while (true) {
+      Element *e = src_elems + k_src;
+      double sa = e->v1->x, sb = e->v2->x;
+      if (k_src != j_coeffs) {
+        src->calculate_elem_coeffs(k_src, y_src, src_coeffs);
+        j_coeffs = k_src;
+      }
+      // the vertex values
+      if (k_src == j) {
+        src->element_solution_point((2*a - sa - sb)/(sb - sa), e, src_coeffs, val, der);
+        for (int c=0; c < n_eq; c++) coeffs[c][0] = val[c];
+      }
+      bool last = (k_src == n_src - 1 || sb >= b - eps);
+      if (last) {
+        src->element_solution_point((2*b - sa - sb)/(sb - sa), e, src_coeffs, val, der);
+        for (int c=0; c < n_eq; c++) coeffs[c][1] = val[c];
+      }
+
+      // bubble right-hand sides, integrated exactly on the overlap (lo, hi)
+      double lo = (sa > a) ? sa : a;
+      double hi = (sb < b) ? sb : b;
+      if (p >= 2 && hi > lo) {
+        int order = e->p + p;
+        double *pts = g_quad_1d_std.get_points(order);
+        double *weights = g_quad_1d_std.get_weights(order);
+        int num = g_quad_1d_std.get_num_points(order);
+        for (int i=0; i < num; i++) {
+          double x = (hi - lo)/2*pts[i] + (hi + lo)/2;
+          double w = weights[i]*(hi - lo)/2;
+          src->element_solution_point((2*x - sa - sb)/(sb - sa), e, src_coeffs, val, der);
+          double x_ref = (2*x - a - b)/(b - a);
+          if (norm == PROJ_H1) {
+            // \int u' l_k' over the reference element
+            for (int k=2; k <= p; k++) {
+              double dl = lobatto_der_tab_1d[k](x_ref)*w;
+              for (int c=0; c < n_eq; c++) coeffs[c][k] += der[c]*dl;
+            }
+          }
+          else {
+            // \int u l_k over the reference element, the linear part is
+            // subtracted below (the vertex values may not be known yet)
+            for (int k=2; k <= p; k++) {
+              double l = lobatto_fn_tab_1d[k](x_ref)*w*2/(b - a);
+              for (int c=0; c < n_eq; c++) coeffs[c][k] += val[c]*l;
+            }
+          }
+        }
+      }
+      if (last) break;
+      k_src++;
+    }
+
+    if (p >= 2 && norm == PROJ_L2) {
+      for (int c=0; c < n_eq; c++) {
+        for (int k=2; k <= p; k++) 
+          coeffs[c][k] -= coeffs[c][0]*g_ref_matrices.mass[k][0] + 
+                          coeffs[c][1]*g_ref_matrices.mass[k][1];
+        cholsl<double>(mass_chol, p - 1, mass_diag, coeffs[c] + 2, coeffs[c] + 2);
+      }
+    }
+
+    for (int c=0; c < n_eq; c++)
+      for (int k=0; k <= p; k++) {
+        int pos = elems[m].dof[c][k];
+        if (pos != -1) y_dest[pos] = coeffs[c][k];
+      }
+    // the next element may start in the last source element
+    j = k_src;
+  }
+  delete [] (char *) mass_chol;
+}
+
+void prolongate_solution(Mesh *src, double *y_src, Mesh *dest, double *y_dest)
+{
+  // for nested meshes the H1 projection-based interpolation reproduces
+  // the source solution exactly where p does not decrease
+  transfer_solution(src, y_src, dest, y_dest, PROJ_H1);
+}
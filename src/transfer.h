@@ -0,0 +1,62 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_TRANSFER_H
+#define __HERMES1D_TRANSFER_H
+
+#include "common.h"
+#include "lobatto.h"
+#include "quad_std.h"
+#include "mesh.h"
+
+// norms of the projections
+#define PROJ_L2 0
+#define PROJ_H1 1
+
+/// Function with n_eq components to be projected: returns the values
+/// val[c] at the point x and, for the H1 projection, the derivatives
+/// der[c].
+typedef void (*projection_fn)(double x, double *val, double *der, void *user_data);
+
+/// Projection-based interpolation of the function fn onto the Lobatto
+/// basis of 'mesh' (e.g. to get an initial guess for Newton's method),
+/// element by element: the vertex values are interpolated, the bubble
+/// coefficients are the projection of the rest in the H1 seminorm (the
+/// derivatives of the bubbles are orthonormal, so no system is solved)
+/// or in the L2 norm (the bubble block of the reference mass matrix is
+/// factorized once). The cost is O(n_elem p^2); the elements are split
+/// among n_threads threads. y has mesh->get_n_dof() entries, the DOF of
+/// Dirichlet conditions are skipped. The integrals use the Gauss rule of
+/// order 2p + 2.
+void project_function(Mesh *mesh, projection_fn fn, void *user_data, double *y, 
+                      int norm=PROJ_H1, int n_threads=1);
+
+/// The same for the solution y_src on another mesh 'src' over the same
+/// interval (the two meshes need not be nested). The source solution is
+/// located by a binary search at every quadrature point, so the integrals
+/// are not exact in target elements spanning several source elements;
+/// transfer_solution() avoids both.
+void project_solution(Mesh *src, double *y_src, Mesh *dest, double *y_dest, 
+                      int norm=PROJ_H1, int n_threads=1);
+
+/// Transfers the solution y_src on the mesh 'src' to the mesh 'dest' over
+/// the same interval (any two meshes, e.g. for adaptivity, continuation
+/// or restarts), for all solution components. y_dest (length
+/// dest->get_n_dof()) gets the projection-based interpolation of the
+/// source solution: the vertex values and the bubble coefficients in the
+/// H1 seminorm or in the L2 norm. Both sorted element arrays are walked
+/// in a single merge pass and the integrals are exact on each overlap of
+/// a source and a target element, so the cost is linear in the total
+/// number of elements.
+void transfer_solution(Mesh *src, double *y_src, Mesh *dest, double *y_dest, 
+                       int norm=PROJ_H1);
+
+/// transfer_solution() in the H1 seminorm to a mesh nested in 'src' (in
+/// h and/or p): the source solution is reproduced exactly where the
+/// degree does not decrease (in unsplit elements the Lobatto coefficients
+/// are simply copied, since the basis is hierarchic).
+void prolongate_solution(Mesh *src, double *y_src, Mesh *dest, double *y_dest);
+
+#endif
@@ -0,0 +1,350 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include <string.h>
+
+#include "writer.h"
+
+static void copy_filename(char *dest, const char *filename)
+{
+  if (strlen(filename) >= MAX_STRING_LENGTH) error("file name too long in SolutionWriter.");
+  strcpy(dest, filename);
+}
+
+TextWriter::TextWriter(const char *filename, bool one_file)
+{
+  copy_filename(this->filename, filename);
+  this->one_file = one_file;
+  this->n_files = 0;
+}
+
+TextWriter::~TextWriter()
+{
+  // closes the files if end() was not called (e.g. after an error)
+  for (int c=0; c < this->n_files; c++) {
+    fclose(this->f[c]);
+    delete [] this->buffers[c];
+  }
+}
+
+void TextWriter::begin(int n_eq)
+{
+  if (n_eq > MAX_EQN_NUM) error("number of equations too high in TextWriter.");
+  this->n_eq = n_eq;
+  int n_files = this->one_file ? 1 : n_eq;
+  for (int c=0; c < n_files; c++) {
+    char name[MAX_STRING_LENGTH + 10];
+    if (n_files == 1) sprintf(name, "%s", this->filename);
+    else sprintf(name, "%s_%d", this->filename, c);
+    this->f[c] = fopen(name, "wb");
+    if (this->f[c] == NULL) error("problem opening file in TextWriter.");
+    this->buffers[c] = new char[WRITER_BUFFER_SIZE];
+    setvbuf(this->f[c], this->buffers[c], _IOFBF, WRITER_BUFFER_SIZE);
+    this->n_files++;
+  }
+}
+
+void TextWriter::write(int n, double *x, double *val)
+{
+  int n_eq = this->n_eq;
+  if (this->one_file) {
+    for (int i=0; i < n; i++) {
+      fprintf(this->f[0], "%.17g", x[i]);
+      for (int c=0; c < n_eq; c++) fprintf(this->f[0], " %.17g", val[i*n_eq + c]);
+      fputc('\n', this->f[0]);
+    }
+  }
+  else {
+    for (int c=0; c < n_eq; c++)
+      for (int i=0; i < n; i++) fprintf(this->f[c], "%g %g\n", x[i], val[i*n_eq + c]);
+  }
+}
+
+void TextWriter::end()
+{
+  for (int c=0; c < this->n_files; c++) {
+    if (this->n_files == 1) printf("Output written to %s.\n", this->filename);
+    else printf("Output written to %s_%d.\n", this->filename, c);
+    fclose(this->f[c]);
+    delete [] this->buffers[c];
+  }
+  this->n_files = 0;
+}
+
+// true on little-endian machines
+static bool little_endian()
+{
+  int one = 1;
+  return *(char *) &one == 1;
+}
+
+BinaryWriter::BinaryWriter(const char *filename)
+{
+  copy_filename(this->filename, filename);
+  this->f = NULL;
+  this->buffer = NULL;
+}
+
+BinaryWriter::~BinaryWriter()
+{
+  if (this->f != NULL) fclose(this->f);
+  delete [] this->buffer;
+}
+
+void BinaryWriter::flush()
+{
+  if (this->buffer_len > 0 && 
+      fwrite(this->buffer, 1, this->buffer_len, this->f) != this->buffer_len)
+    error("problem writing file in BinaryWriter.");
+  this->buffer_len = 0;
+}
+
+// appends 'size' bytes (one number) in little-endian order
+void BinaryWriter::put(const void *data, int size)
+{
+  if (this->buffer_len + size > WRITER_BUFFER_SIZE) this->flush();
+  char *dest = this->buffer + this->buffer_len;
+  if (little_endian()) memcpy(dest, data, size);
+  else for (int k=0; k < size; k++) dest[k] = ((const char *) data)[size - 1 - k];
+  this->buffer_len += size;
+}
+
+void BinaryWriter::begin(int n_eq)
+{
+  this->f = fopen(this->filename, "wb");
+  if (this->f == NULL) error("problem opening file in BinaryWriter.");
+  this->buffer = new char[WRITER_BUFFER_SIZE];
+  this->buffer_len = 0;
+  this->n_eq = n_eq;
+  this->n_pts = 0;
+  int n = n_eq;
+  memcpy(this->buffer, "H1DSOL01", 8);
+  this->buffer_len = 8;
+  this->put(&n, 4);
+  // the number of points is filled in by end()
+  this->put(&this->n_pts, 8);
+}
+
+void BinaryWriter::write(int n, double *x, double *val)
+{
+  for (int i=0; i < n; i++) {
+    this->put(x + i, 8);
+    for (int c=0; c < this->n_eq; c++) this->put(val + i*this->n_eq + c, 8);
+  }
+  this->n_pts += n;
+}
+
+void BinaryWriter::end()
+{
+  this->flush();
+  fseek(this->f, 12, SEEK_SET);
+  this->put(&this->n_pts, 8);
+  this->flush();
+  fclose(this->f);
+  this->f = NULL;
+  delete [] this->buffer;
+  this->buffer = NULL;
+  printf("Output written to %s.\n", this->filename);
+}
+
+// writes one number in the big-endian order of the VTK binary format
+static void put_big_endian(FILE *f, const void *data, int size)
+{
+  char bytes[8];
+  if (little_endian()) 
+    for (int k=0; k < size; k++) bytes[k] = ((const char *) data)[size - 1 - k];
+  else memcpy(bytes, data, size);
+  fwrite(bytes, 1, size, f);
+}
+
+VtkWriter::VtkWriter(const char *filename)
+{
+  copy_filename(this->filename, filename);
+}
+
+void VtkWriter::begin(int n_eq)
+{
+  this->n_eq = n_eq;
+  this->x.clear();
+  this->val.clear();
+}
+
+void VtkWriter::write(int n, double *x, double *val)
+{
+  this->x.insert(this->x.end(), x, x + n);
+  this->val.insert(this->val.end(), val, val + n*this->n_eq);
+}
+
+void VtkWriter::end()
+{
+  FILE *f = fopen(this->filename, "wb");
+  if (f == NULL) error("problem opening file in VtkWriter.");
+  char *buffer = new char[WRITER_BUFFER_SIZE];
+  setvbuf(f, buffer, _IOFBF, WRITER_BUFFER_SIZE);
+  int n = this->x.size();
+  fprintf(f, "# vtk DataFile Version 3.0\n");
+  fprintf(f, "Hermes1D solution\n");
+  fprintf(f, "BINARY\n");
+  fprintf(f, "DATASET POLYDATA\n");
+  fprintf(f, "POINTS %d double\n", n);
+  double zero = 0;
+  for (int i=0; i < n; i++) {
+    put_big_endian(f, &this->x[i], 8);
+    put_big_endian(f, &zero, 8);
+    put_big_endian(f, &zero, 8);
+  }
+  fprintf(f, "\nLINES 1 %d\n", n + 1);
+  put_big_endian(f, &n, 4);
+  for (int i=0; i < n; i++) put_big_endian(f, &i, 4);
+  fprintf(f, "\nPOINT_DATA %d\n", n);
+  for (int c=0; c < this->n_eq; c++) {
+    fprintf(f, "SCALARS u_%d double 1\n", c);
+    fprintf(f, "LOOKUP_TABLE default\n");
+    for (int i=0; i < n; i++) put_big_endian(f, &this->val[i*this->n_eq + c], 8);
+    fprintf(f, "\n");
+  }
+  fclose(f);
+  delete [] buffer;
+  this->x.clear();
+  this->val.clear();
+  printf("Output written to %s.\n", this->filename);
+}
+
+SolutionWriter *new_solution_writer(int format, const char *filename)
+{
+  switch (format) {
+    case OUT_GNUPLOT: return new TextWriter(filename, false);
+    case OUT_COLUMNS: return new TextWriter(filename, true);
+    case OUT_BINARY:  return new BinaryWriter(filename);
+    case OUT_VTK:     return new VtkWriter(filename);
+  }
+  error("unknown output format in new_solution_writer().");
+  return NULL;
+}
+
+AsyncWriter::AsyncWriter(Mesh *mesh, int max_queued)
+{
+  this->mesh = mesh;
+  this->n_dof = mesh->get_n_dof();
+  this->max_queued = (max_queued < 1) ? 1 : max_queued;
+  this->busy = false;
+  this->quit = false;
+  this->n_written = 0;
+  pthread_mutex_init(&this->lock, NULL);
+  pthread_cond_init(&this->cond, NULL);
+  if (pthread_create(&this->thread, NULL, AsyncWriter::worker, this) != 0)
+    error("cannot create thread in AsyncWriter.");
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  pthread_mutex_lock(&this->lock);
+  this->quit = true;
+  pthread_cond_broadcast(&this->cond);
+  pthread_mutex_unlock(&this->lock);
+  pthread_join(this->thread, NULL);
+  if (!this->error_msg.empty()) 
+    fprintf(stderr, "AsyncWriter: snapshot not written: %s\n", this->error_msg.c_str());
+  for (int i=0; i < this->free_buffers.size(); i++) delete [] this->free_buffers[i];
+  pthread_mutex_destroy(&this->lock);
+  pthread_cond_destroy(&this->cond);
+}
+
+void *AsyncWriter::worker(void *data)
+{
+  ((AsyncWriter *) data)->run();
+  return NULL;
+}
+
+void AsyncWriter::run()
+{
+  Linearizer l(this->mesh);
+  pthread_mutex_lock(&this->lock);
+  while (true) {
+    // the pending snapshots are written before quitting
+    while (this->queue.empty() && !this->quit) 
+      pthread_cond_wait(&this->cond, &this->lock);
+    if (this->queue.empty()) break;
+    Snapshot s = this->queue.front();
+    this->queue.pop_front();
+    this->busy = true;
+    pthread_mutex_unlock(&this->lock);
+
+    std::string msg;
+    try {
+      if (s.tol > 0) l.save_solution_adaptive(s.filename.c_str(), s.y, s.format, s.tol);
+      else l.save_solution(s.filename.c_str(), s.y, s.format, s.subdivision);
+    }
+    catch (std::runtime_error &e) {
+      msg = e.what();
+    }
+
+    pthread_mutex_lock(&this->lock);
+    if (!msg.empty() && this->error_msg.empty()) this->error_msg = msg;
+    else if (msg.empty()) this->n_written++;
+    this->free_buffers.push_back(s.y);
+    this->busy = false;
+    pthread_cond_broadcast(&this->cond);
+  }
+  pthread_mutex_unlock(&this->lock);
+}
+
+int AsyncWriter::get_n_written()
+{
+  pthread_mutex_lock(&this->lock);
+  int n = this->n_written;
+  pthread_mutex_unlock(&this->lock);
+  return n;
+}
+
+// reports the first error of the background thread (called with the lock)
+void AsyncWriter::check_error()
+{
+  if (this->error_msg.empty()) return;
+  std::string msg = this->error_msg;
+  this->error_msg.clear();
+  pthread_mutex_unlock(&this->lock);
+  error(msg.c_str());
+}
+
+void AsyncWriter::submit(const char *filename, double *y, int format, 
+                         int plotting_elem_subdivision, double tol)
+{
+  pthread_mutex_lock(&this->lock);
+  check_error();
+  // bounded queue: wait for the writer
+  while (this->queue.size() >= this->max_queued) 
+    pthread_cond_wait(&this->cond, &this->lock);
+  double *buffer;
+  if (this->free_buffers.empty()) buffer = new double[this->n_dof];
+  else {
+    buffer = this->free_buffers.back();
+    this->free_buffers.pop_back();
+  }
+  pthread_mutex_unlock(&this->lock);
+
+  // the copy is made without the lock, the writer may be busy meanwhile
+  for (int i=0; i < this->n_dof; i++) buffer[i] = y[i];
+  Snapshot s;
+  s.filename = filename;
+  s.y = buffer;
+  s.format = format;
+  s.subdivision = plotting_elem_subdivision;
+  s.tol = tol;
+
+  pthread_mutex_lock(&this->lock);
+  this->queue.push_back(s);
+  pthread_cond_broadcast(&this->cond);
+  pthread_mutex_unlock(&this->lock);
+}
+
+void AsyncWriter::flush()
+{
+  pthread_mutex_lock(&this->lock);
+  while (!this->queue.empty() || this->busy) 
+    pthread_cond_wait(&this->cond, &this->lock);
+  check_error();
+  pthread_mutex_unlock(&this->lock);
+}
@@ -0,0 +1,148 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_WRITER_H
+#define __HERMES1D_WRITER_H
+
+#include <pthread.h>
+#include <string>
+#include <deque>
+#include <vector>
+
+#include "common.h"
+#include "mesh.h"
+
+// output formats of the Linearizer
+#define OUT_GNUPLOT 0  // one text file "x u_c" per component (name_c if n_eq > 1)
+#define OUT_COLUMNS 1  // one text file "x u_0 u_1 ...", full precision
+#define OUT_BINARY 2   // raw little-endian doubles with a header, see BinaryWriter
+#define OUT_VTK 3      // VTK legacy binary polyline, one scalar field per component
+
+// size of the output buffers
+const int WRITER_BUFFER_SIZE = 1 << 20;
+
+/// Sink for the points of a linearized solution. The Linearizer calls
+/// begin() once, then write() for blocks of points in increasing x, and
+/// end() once, which finishes the output.
+class SolutionWriter {
+public:
+    virtual ~SolutionWriter() {}
+    virtual void begin(int n_eq) = 0;
+    // n points x[i] with the values val[i*n_eq + c]
+    virtual void write(int n, double *x, double *val) = 0;
+    virtual void end() = 0;
+};
+
+/// Text output of the Linearizer with large stdio buffers; with one_file
+/// all components are columns of one file, otherwise every component has
+/// its own two-column file (the traditional Gnuplot output, "%g").
+class TextWriter : public SolutionWriter {
+public:
+    TextWriter(const char *filename, bool one_file);
+    virtual ~TextWriter();
+    virtual void begin(int n_eq);
+    virtual void write(int n, double *x, double *val);
+    virtual void end();
+private:
+    char filename[MAX_STRING_LENGTH];
+    bool one_file;
+    int n_eq, n_files;
+    FILE *f[MAX_EQN_NUM];
+    char *buffers[MAX_EQN_NUM];
+};
+
+/// Raw binary output: the header is the 8 bytes "H1DSOL01", the number
+/// of components n_eq (int32) and the number of points (int64), followed
+/// by the records x, u_0, ..., u_{n_eq-1} of every point (doubles). All
+/// numbers are little-endian.
+class BinaryWriter : public SolutionWriter {
+public:
+    BinaryWriter(const char *filename);
+    virtual ~BinaryWriter();
+    virtual void begin(int n_eq);
+    virtual void write(int n, double *x, double *val);
+    virtual void end();
+private:
+    char filename[MAX_STRING_LENGTH];
+    FILE *f;
+    int n_eq;
+    long long n_pts;
+    // output buffer, flushed by fwrite when full
+    char *buffer;
+    int buffer_len;
+    void put(const void *data, int size);
+    void flush();
+};
+
+/// VTK legacy polyline through all points with the scalar fields
+/// u_0, ..., u_{n_eq-1}, in the binary (big-endian) variant. The format
+/// needs the number of points before the points and the fields after
+/// them, so the data are kept in memory until end().
+class VtkWriter : public SolutionWriter {
+public:
+    VtkWriter(const char *filename);
+    virtual void begin(int n_eq);
+    virtual void write(int n, double *x, double *val);
+    virtual void end();
+private:
+    char filename[MAX_STRING_LENGTH];
+    int n_eq;
+    std::vector<double> x, val;
+};
+
+/// writer of the format 'format' (one of OUT_*), to be deleted by the caller
+SolutionWriter *new_solution_writer(int format, const char *filename);
+
+/// Writes solution snapshots (e.g. after Newton iterations or time steps)
+/// on a background thread, so that the solver does not wait for the
+/// output. submit() copies the coefficient vector into a snapshot buffer
+/// and returns; the thread linearizes and writes it. At most max_queued
+/// snapshots wait, submit() blocks while the queue is full, and the
+/// buffers of written snapshots are reused. The mesh must not change
+/// while snapshots are pending. An error in the background thread is
+/// reported (by error()) from the next submit() or flush().
+class AsyncWriter {
+public:
+    AsyncWriter(Mesh *mesh, int max_queued=2);
+    // waits for the pending snapshots, an error not reported yet is
+    // printed to stderr (a destructor cannot throw)
+    ~AsyncWriter();
+
+    // Queues the solution y (length n_dof) for save_solution(filename, y,
+    // format, plotting_elem_subdivision), or for save_solution_adaptive()
+    // with the tolerance 'tol' if it is positive.
+    void submit(const char *filename, double *y, int format=OUT_GNUPLOT, 
+                int plotting_elem_subdivision=50, double tol=0);
+    // waits until all submitted snapshots are written
+    void flush();
+    // number of snapshots written so far
+    int get_n_written();
+
+private:
+    struct Snapshot {
+        std::string filename;
+        double *y;
+        int format, subdivision;
+        double tol;
+    };
+    Mesh *mesh;
+    int n_dof;
+    int max_queued;
+    std::deque<Snapshot> queue;
+    std::vector<double *> free_buffers;
+    bool busy;          // a snapshot is being written
+    bool quit;
+    int n_written;
+    std::string error_msg;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    static void *worker(void *data);
+    void run();
+    void check_error();
+};
+
+#endif